@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# end to end throughput benchmark
+#
+# generates deterministic input with pcap_gen into memory (tmpfs) once per format, then runs
+# pcap_split over every input format / output mode / split setting. one JSON object per run
+# is written to stdout so results can be diffed release to release
+#
+# BENCH_DIR   scratch directory, should be tmpfs (default /dev/shm/pcap_split_bench)
+# BENCH_PKTS  packets per input (default 5e6)
+# BENCH_SIZE  pcap_gen packet size mix (default imix)
+#
+
+BIN=${BENCH_BIN:-./pcap_split}
+GEN=${BENCH_GEN:-./pcap_gen}
+DIR=${BENCH_DIR:-/dev/shm/pcap_split_bench}
+PKTS=${BENCH_PKTS:-5e6}
+SIZE=${BENCH_SIZE:-imix}
+
+VERSION=`git describe --always --dirty 2>/dev/null`
+
+FORMATS="pcap-nsec pcap-usec fmad"
+OUTPUTS="null cat io-uring"
+SPLITS=("--split-byte 1e9" "--split-time 1e9" "--split-time 60e9 --split-byte 100e6")
+
+mkdir -p $DIR || exit 1
+
+for FORMAT in $FORMATS; do
+
+	# 1M packets per second of capture time
+	$GEN --format $FORMAT --pkts $PKTS --size $SIZE --rate 1e6 > $DIR/input.$FORMAT 2>/dev/null || exit 1
+
+	for OUTPUT in $OUTPUTS; do
+		case $OUTPUT in
+		null)		OUTARG="--null" ;;
+		cat)		OUTARG="" ;;
+		io-uring)	OUTARG="--io-uring" ;;
+		esac
+
+		for SPLIT in "${SPLITS[@]}"; do
+			rm -rf $DIR/out
+			mkdir -p $DIR/out
+
+			SUMMARY=`$BIN -o $DIR/out/split_ $SPLIT $OUTARG < $DIR/input.$FORMAT 2>/dev/null | grep "^Summary:"`
+
+			# Summary: Bytes <n> Pkts <n> Splits <n> Time <sec> sec Speed <gbps> Gbps <mpps> Mpps
+			set -- $SUMMARY
+			echo "{\"version\":\"$VERSION\",\"format\":\"$FORMAT\",\"size\":\"$SIZE\",\"output\":\"$OUTPUT\",\"split\":\"$SPLIT\",\"bytes\":${3:-0},\"pkts\":${5:-0},\"splits\":${7:-0},\"sec\":${9:-0},\"gbps\":${12:-0},\"mpps\":${14:-0}}"
+		done
+	done
+	rm -f $DIR/input.$FORMAT
+done
+
+rm -rf $DIR/out
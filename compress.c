@@ -0,0 +1,219 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// parallel pipe-cmd workers for closed splits
+//
+// with a heavy --pipe-cmd (zstd -19, xz) and short splits a single compressor process
+// becomes the bottleneck, as there is only ever one open split. instead the main loop writes
+// the raw split to local staging at full speed and on close queues it here. N workers each
+// run the full output command with the raw split as stdin, so N splits compress at once on
+// N cores. finished splits are renamed from the worker and the raw file deleted
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "fTypes.h"
+#include "compress.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define COMPRESS_QUEUE_MAX				1024				// splits waiting, the writer blocks beyond this
+#define COMPRESS_WORKER_MAX				256
+#define COMPRESS_DONE_MAX				1024				// finished names waiting to be reaped
+
+typedef struct
+{
+	u8					Raw[1024];
+	u8					Cmd[16*1024];
+	u8					FileNamePending[1024];
+	u8					FileName[1024];
+	u8					Script[4096];						// run once FileName exists, empty for none
+
+} CompressJob_t;
+
+static u32				s_WorkerCnt			= 0;
+static pthread_t		s_Worker[COMPRESS_WORKER_MAX];
+static CompressDone_f*	s_Done				= NULL;
+
+static pthread_mutex_t	s_Lock				= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	s_CondPut			= PTHREAD_COND_INITIALIZER;	// job queued
+static pthread_cond_t	s_CondGet			= PTHREAD_COND_INITIALIZER;	// slot freed
+static CompressJob_t*	s_Queue				= NULL;
+static u32				s_QueuePut			= 0;
+static u32				s_QueueGet			= 0;
+static u32				s_QueueWait			= 0;				// queued, not yet picked up
+static volatile u32		s_QueueDepth		= 0;				// queued + in progress
+static volatile bool	s_ThreadExit		= false;
+
+// finished splits, drained by Compress_Reap
+static u8				s_DoneName[COMPRESS_DONE_MAX][1024];
+static u32				s_DonePut			= 0;
+static u32				s_DoneGet			= 0;
+
+static volatile u64		s_DoneCnt			= 0;
+static volatile u64		s_RawByte			= 0;				// uncompressed bytes processed
+
+//---------------------------------------------------------------------------------------------
+
+static void* CompressThread(void* User)
+{
+	CompressJob_t* Job = malloc(sizeof(CompressJob_t));
+	assert(Job != NULL);
+
+	while (true)
+	{
+		pthread_mutex_lock(&s_Lock);
+		while ((s_QueueWait == 0) && !s_ThreadExit)
+		{
+			pthread_cond_wait(&s_CondPut, &s_Lock);
+		}
+		if (s_QueueWait == 0)
+		{
+			pthread_mutex_unlock(&s_Lock);
+			break;
+		}
+		memcpy(Job, &s_Queue[s_QueueGet], sizeof(CompressJob_t));
+		s_QueueGet = (s_QueueGet + 1) % COMPRESS_QUEUE_MAX;
+		s_QueueWait--;
+		pthread_mutex_unlock(&s_Lock);
+
+		struct stat st;
+		u64 Size = (stat(Job->Raw, &st) == 0) ? st.st_size : 0;
+
+		u8 Cmd[17*1024];
+		sprintf(Cmd, "( %s ) < '%s'", Job->Cmd, Job->Raw);
+
+		int Status = system(Cmd);
+		bool IsDone = WIFEXITED(Status) && (WEXITSTATUS(Status) == 0);
+		if (!IsDone)
+		{
+			// raw split is kept so nothing is lost
+			fprintf(stderr, "compress [%s] failed %i, kept [%s]\n", Cmd, Status, Job->Raw);
+		}
+		else
+		{
+			s_Done(Job->FileNamePending, Job->FileName);
+			unlink(Job->Raw);
+
+			if (Job->Script[0])
+			{
+				printf("Script [%s]\n", Job->Script);
+				system(Job->Script);
+			}
+
+			__atomic_add_fetch(&s_DoneCnt, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&s_RawByte, Size, __ATOMIC_RELAXED);
+		}
+
+		pthread_mutex_lock(&s_Lock);
+		if (IsDone && (s_DonePut - s_DoneGet < COMPRESS_DONE_MAX))
+		{
+			strcpy(s_DoneName[s_DonePut % COMPRESS_DONE_MAX], Job->FileName);
+			s_DonePut++;
+		}
+		s_QueueDepth--;
+		pthread_cond_broadcast(&s_CondGet);
+		pthread_mutex_unlock(&s_Lock);
+	}
+
+	free(Job);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Compress_Open(u32 WorkerCnt, CompressDone_f* Done)
+{
+	s_WorkerCnt = WorkerCnt;
+	if (s_WorkerCnt == 0) s_WorkerCnt = 1;
+	if (s_WorkerCnt > COMPRESS_WORKER_MAX) s_WorkerCnt = COMPRESS_WORKER_MAX;
+
+	s_Done	= Done;
+	s_Queue	= calloc(COMPRESS_QUEUE_MAX, sizeof(CompressJob_t));
+	assert(s_Queue != NULL);
+
+	for (int i=0; i < s_WorkerCnt; i++)
+	{
+		pthread_create(&s_Worker[i], NULL, CompressThread, NULL);
+	}
+	fprintf(stderr, "compress: %i workers\n", s_WorkerCnt);
+}
+
+void Compress_Close(void)
+{
+	if (!s_Queue) return;
+
+	if (s_QueueDepth > 0) printf("compress: waiting for %i splits\n", s_QueueDepth);
+
+	pthread_mutex_lock(&s_Lock);
+	s_ThreadExit = true;
+	pthread_cond_broadcast(&s_CondPut);
+	pthread_mutex_unlock(&s_Lock);
+
+	for (int i=0; i < s_WorkerCnt; i++)
+	{
+		pthread_join(s_Worker[i], NULL);
+	}
+
+	free(s_Queue);
+	s_Queue = NULL;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Compress_Queue(u8* RawFile, u8* Cmd, u8* FileNamePending, u8* FileName, u8* Script)
+{
+	pthread_mutex_lock(&s_Lock);
+
+	// every worker busy and the queue full, hold the writer
+	while (s_QueueDepth >= COMPRESS_QUEUE_MAX)
+	{
+		pthread_cond_wait(&s_CondGet, &s_Lock);
+	}
+
+	CompressJob_t* Job = &s_Queue[s_QueuePut];
+	strncpy(Job->Raw,				RawFile,			sizeof(Job->Raw) - 1);
+	strncpy(Job->Cmd,				Cmd,				sizeof(Job->Cmd) - 1);
+	strncpy(Job->FileNamePending,	FileNamePending,	sizeof(Job->FileNamePending) - 1);
+	strncpy(Job->FileName,			FileName,			sizeof(Job->FileName) - 1);
+	strncpy(Job->Script,			Script ? Script : (u8*)"",	sizeof(Job->Script) - 1);
+	s_QueuePut = (s_QueuePut + 1) % COMPRESS_QUEUE_MAX;
+
+	s_QueueDepth++;
+	s_QueueWait++;
+
+	pthread_cond_signal(&s_CondPut);
+	pthread_mutex_unlock(&s_Lock);
+}
+
+u32 Compress_Reap(u8 FileName[][1024], u32 Max)
+{
+	u32 Count = 0;
+
+	pthread_mutex_lock(&s_Lock);
+	while ((s_DoneGet != s_DonePut) && (Count < Max))
+	{
+		strcpy(FileName[Count++], s_DoneName[s_DoneGet % COMPRESS_DONE_MAX]);
+		s_DoneGet++;
+	}
+	pthread_mutex_unlock(&s_Lock);
+
+	return Count;
+}
+
+void Compress_Stats(u64* pDoneCnt, u64* pRawByte, u32* pQueueDepth)
+{
+	if (pDoneCnt)		pDoneCnt[0]		= s_DoneCnt;
+	if (pRawByte)		pRawByte[0]		= s_RawByte;
+	if (pQueueDepth)	pQueueDepth[0]	= s_QueueDepth;
+}
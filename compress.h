@@ -0,0 +1,28 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// parallel pipe-cmd workers for closed splits
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+// called from a worker once Cmd has finished, moves the output to its final name
+typedef void		CompressDone_f		(u8* FileNamePending, u8* FileName);
+
+void				Compress_Open		(u32 WorkerCnt, CompressDone_f* Done);
+
+// drains every queued split
+void				Compress_Close		(void);
+
+// run "Cmd < RawFile" in a worker, then Done(), then delete RawFile and run Script (can be NULL)
+void				Compress_Queue		(u8* RawFile, u8* Cmd, u8* FileNamePending, u8* FileName, u8* Script);
+
+// final names of splits finished since the last call, for the main thread
+u32					Compress_Reap		(u8 FileName[][1024], u32 Max);
+
+void				Compress_Stats		(u64* pDoneCnt, u64* pRawByte, u32* pQueueDepth);
+
+#endif
@@ -0,0 +1,259 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// duplicate packet elimination
+//
+// SPAN / TAP aggregation often delivers the same packet twice a few usec apart. every packet
+// is fingerprinted with two independent hashes, CRC32C (SSE4.2 crc32 instruction, 8 bytes per
+// cycle) and a multiply accumulate sum, then looked up in a table of 64 byte buckets holding
+// 4 entries each, so a lookup touches a single cache line. a match with the same length seen
+// within the window is a duplicate. entries older than the window are reused, otherwise the
+// oldest entry in the bucket is evicted
+//
+// the ttl / hop limit and ipv4 header checksum can be masked out, for copies taken either side
+// of a router
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#include "fTypes.h"
+#include "dedup.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define DEDUP_WAYS						4					// entries per bucket
+#define DEDUP_MASK_BYTES				64					// leading bytes copied for ttl masking
+
+#define ETHER_TYPE_IPV4					0x0800
+#define ETHER_TYPE_IPV6					0x86dd
+#define ETHER_TYPE_VLAN					0x8100
+#define ETHER_TYPE_QINQ					0x88a8
+
+typedef struct
+{
+	u64				TS;									// full nanosecond timestamp, 0 for empty
+	u32				CRC;								// first hash, includes the length
+	u32				Sum;								// second hash, low half. the high half picks the bucket
+
+} DedupEntry_t;
+
+typedef struct
+{
+	DedupEntry_t	Entry[DEDUP_WAYS];
+
+} __attribute__((aligned(64))) DedupBucket_t;
+
+static DedupConfig_t	s_Config;
+
+static DedupBucket_t*	s_Bucket		= NULL;
+static u32				s_BucketMask	= 0;
+static u64				s_Window		= 0;				// window in nanoseconds
+
+static bool				s_IsSSE42		= false;
+
+static u64				s_DupPkt		= 0;
+static u64				s_Evict			= 0;				// live entries pushed out before their window ended
+
+//---------------------------------------------------------------------------------------------
+// both hashes in a single pass over the packet. crc32c is linear over GF(2) and the sum over
+// the integers, a collision needs to hit both
+
+typedef struct
+{
+	u32				CRC;
+	u64				Sum;
+
+} DedupHash_t;
+
+// last partial word, zero padded
+static INLINE u64 HashTail(u8* Data, u32 Length)
+{
+	u64 w = 0;
+	memcpy(&w, Data, Length);
+	return w;
+}
+
+static __attribute__((target("sse4.2"))) void HashSSE42(DedupHash_t* H, u8* Data, u32 Length)
+{
+	u64 CRC = H->CRC;
+	u64 Sum = H->Sum;
+
+	u32 i = 0;
+	for (; i + 8 <= Length; i += 8)
+	{
+		u64 w;
+		memcpy(&w, Data + i, 8);
+
+		CRC = _mm_crc32_u64(CRC, w);
+		Sum = (Sum + w) * 0x9e3779b97f4a7c15ULL;
+	}
+	if (i < Length)
+	{
+		u64 w = HashTail(Data + i, Length - i);
+
+		CRC = _mm_crc32_u64(CRC, w);
+		Sum = (Sum + w) * 0x9e3779b97f4a7c15ULL;
+	}
+
+	H->CRC = CRC;
+	H->Sum = Sum;
+}
+
+// cpus without sse4.2, fold each word into the crc slot with a multiply instead
+static void HashGeneric(DedupHash_t* H, u8* Data, u32 Length)
+{
+	u64 CRC = H->CRC;
+	u64 Sum = H->Sum;
+
+	for (u32 i=0; i < Length; i += 8)
+	{
+		u64 w;
+		if (i + 8 <= Length)	memcpy(&w, Data + i, 8);
+		else					w = HashTail(Data + i, Length - i);
+
+		CRC = ((CRC ^ w) * 0xc4ceb9fe1a85ec53ULL) >> 32;
+		Sum = (Sum + w) * 0x9e3779b97f4a7c15ULL;
+	}
+
+	H->CRC = CRC;
+	H->Sum = Sum;
+}
+
+static INLINE void Hash(DedupHash_t* H, u8* Data, u32 Length)
+{
+	if (s_IsSSE42)	HashSSE42(H, Data, Length);
+	else			HashGeneric(H, Data, Length);
+}
+
+//---------------------------------------------------------------------------------------------
+
+static INLINE u16 Load16BE(u8* p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+// zero the ttl / hop limit and ipv4 checksum in a copy of the leading bytes
+static void MaskTTL(u8* Data, u32 Length)
+{
+	if (Length < 14) return;
+
+	u32 Type	= Load16BE(Data + 12);
+	u32 Pos		= 14;
+
+	for (int i=0; i < 2; i++)
+	{
+		if ((Type != ETHER_TYPE_VLAN) && (Type != ETHER_TYPE_QINQ)) break;
+		if (Pos + 4 > Length) return;
+
+		Type = Load16BE(Data + Pos + 2);
+		Pos += 4;
+	}
+
+	if ((Type == ETHER_TYPE_IPV4) && (Pos + 12 <= Length))
+	{
+		Data[Pos + 8]	= 0;
+		Data[Pos + 10]	= 0;
+		Data[Pos + 11]	= 0;
+	}
+	else if ((Type == ETHER_TYPE_IPV6) && (Pos + 8 <= Length))
+	{
+		Data[Pos + 7]	= 0;
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Dedup_Open(DedupConfig_t* Config)
+{
+	s_Config = *Config;
+
+	u32 BucketCnt = 1;
+	while (BucketCnt * DEDUP_WAYS < s_Config.TableSize) BucketCnt <<= 1;
+
+	s_Bucket = aligned_alloc(64, BucketCnt * sizeof(DedupBucket_t));
+	assert(s_Bucket != NULL);
+	memset(s_Bucket, 0, BucketCnt * sizeof(DedupBucket_t));
+
+	s_BucketMask	= BucketCnt - 1;
+	s_Window		= s_Config.Window;
+
+	s_IsSSE42		= __builtin_cpu_supports("sse4.2");
+
+	fprintf(stderr, "dedup: Window %.3f msec Table %i entries %.2f MB%s%s\n",	s_Config.Window / 1e6,
+																				BucketCnt * DEDUP_WAYS,
+																				BucketCnt * sizeof(DedupBucket_t) / (double)kMB(1),
+																				s_IsSSE42 ? " crc32c" : " generic hash",
+																				s_Config.IsIgnoreTTL ? " ignore ttl" : "");
+}
+
+bool Dedup_Packet(s64 TS, u8* Payload, u32 Length)
+{
+	DedupHash_t H = { .CRC = Length, .Sum = Length };
+
+	if (s_Config.IsIgnoreTTL)
+	{
+		u8 Head[DEDUP_MASK_BYTES];
+		u32 HeadLen = min32(Length, DEDUP_MASK_BYTES);
+
+		memcpy(Head, Payload, HeadLen);
+		MaskTTL(Head, HeadLen);
+
+		Hash(&H, Head, HeadLen);
+		Hash(&H, Payload + HeadLen, Length - HeadLen);
+	}
+	else
+	{
+		Hash(&H, Payload, Length);
+	}
+
+	// 0 marks an empty entry
+	u64 Now = (u64)TS | 1;
+	u32 Sum = (u32)H.Sum;
+
+	DedupBucket_t* B = &s_Bucket[(H.CRC ^ (H.Sum >> 32)) & s_BucketMask];
+
+	s32 Oldest		= 0;
+	u64 OldestAge	= 0;
+	for (int i=0; i < DEDUP_WAYS; i++)
+	{
+		DedupEntry_t* E = &B->Entry[i];
+
+		// slightly out of order input gives a negative age
+		s64 dT	= (s64)(Now - E->TS);
+		u64 Age	= (E->TS == 0) ? (u64)-1 : (dT < 0) ? -dT : dT;
+
+		if ((E->CRC == H.CRC) && (E->Sum == Sum) && (Age <= s_Window))
+		{
+			s_DupPkt++;
+			return true;
+		}
+		if (Age > OldestAge)
+		{
+			Oldest		= i;
+			OldestAge	= Age;
+		}
+	}
+
+	if (OldestAge <= s_Window) s_Evict++;
+
+	DedupEntry_t* E = &B->Entry[Oldest];
+	E->CRC		= H.CRC;
+	E->Sum		= Sum;
+	E->TS		= Now;
+
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Dedup_Stats(u64* pDupPkt, u64* pEvict)
+{
+	if (pDupPkt)	pDupPkt[0]	= s_DupPkt;
+	if (pEvict)		pEvict[0]	= s_Evict;
+}
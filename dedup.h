@@ -0,0 +1,27 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// duplicate packet elimination
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __DEDUP_H__
+#define __DEDUP_H__
+
+typedef struct
+{
+	u64				Window;								// nanoseconds a packet is remembered for
+	u32				TableSize;							// number of entries, rounded up to a power of 2
+	bool			IsIgnoreTTL;						// mask ip ttl / hop limit and ipv4 checksum before hashing
+
+} DedupConfig_t;
+
+void				Dedup_Open			(DedupConfig_t* Config);
+
+// true if the same packet was seen within the window
+bool				Dedup_Packet		(s64 TS, u8* Payload, u32 Length);
+
+void				Dedup_Stats			(u64* pDupPkt, u64* pEvict);
+
+#endif
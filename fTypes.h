@@ -187,6 +187,7 @@ static u64 clock2ns(int year, int month, int day, int hour, int min, int sec)
 	t.tm_hour	= hour;
 	t.tm_min	= min;
 	t.tm_sec	= sec;
+	t.tm_isdst	= -1;						// let mktime work out DST for the date
 
 	time_t epoch = mktime(&t);
 	return (u64)epoch * (u64)1e9; 
@@ -202,6 +203,7 @@ static u64 clock_date2ns(clock_date_t d)
 	t.tm_hour	= d.hour;
 	t.tm_min	= d.min;
 	t.tm_sec	= d.sec;
+	t.tm_isdst	= -1;
 
 	time_t epoch = mktime(&t);
 	return (u64)epoch * (u64)1e9; 
@@ -220,6 +222,7 @@ static clock_date_t clock_startofweek(clock_date_t d)
 	t.tm_hour	= d.hour;
 	t.tm_min	= d.min;
 	t.tm_sec	= d.sec;
+	t.tm_isdst	= -1;
 
 	mktime(&t);
 
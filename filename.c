@@ -0,0 +1,411 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// split filename templates
+//
+// the template is parsed once at startup into a list of ops, so naming a split is a walk
+// over the list writing digits, with no format string parsing. the utc offset comes from
+// the tz transition table at the packet time, not the wall clock, so names stay correct
+// across a DST change. the local date is cached per hour
+//
+// %Y %m %d %H %M %S      local time of the split start
+// %z                     utc offset at the split start, +hh:mm
+// %<other>               any other strftime conversion
+// {start} {end}          epoch seconds of the split start / end. {start.ms} .us .ns
+// {ms} {us} {ns}         3 digit milli / micro / nano part of the split start
+// {seq}                  split number
+// {host}                 hostname
+// {hash}                 8 hex digits hashed from the split start
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "fTypes.h"
+#include "filename.h"
+#include "tz.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define OP_LITERAL						0
+#define OP_YEAR							1
+#define OP_MONTH						2
+#define OP_DAY							3
+#define OP_HOUR							4
+#define OP_MIN							5
+#define OP_SEC							6
+#define OP_TZ							7
+#define OP_STRFTIME						8
+#define OP_START						9					// start / Div
+#define OP_END							10					// end / Div
+#define OP_FRAC							11					// (start / Div) % 1000
+#define OP_SEQ							12
+#define OP_HASH							13
+
+#define OP_MAX							256
+
+typedef struct
+{
+	u32					Op;
+	u64					Div;
+	u32					Length;								// literal bytes
+	u8*					Str;								// literal or strftime conversion
+
+} FileNameOp_t;
+
+// local date for one hour of local time
+typedef struct
+{
+	s64					Hour;
+	struct tm			tm;
+
+} HourCache_t;
+
+static FileNameOp_t		s_Op[OP_MAX];
+static u32				s_OpCnt			= 0;
+
+static HourCache_t		s_Hour			= { .Hour = -1 };
+
+//---------------------------------------------------------------------------------------------
+
+static void OpAdd(u32 Op, u64 Div, u8* Str, u32 Length)
+{
+	assert(s_OpCnt < OP_MAX);
+
+	FileNameOp_t* O = &s_Op[s_OpCnt++];
+	O->Op		= Op;
+	O->Div		= Div;
+	O->Length	= Length;
+	O->Str		= NULL;
+	if (Str)
+	{
+		O->Str = malloc(Length + 1);
+		memcpy(O->Str, Str, Length);
+		O->Str[Length] = 0;
+	}
+}
+
+static void OpLiteral(u8* Str, u32 Length)
+{
+	if (Length == 0) return;
+
+	// merge with the previous literal
+	if ((s_OpCnt > 0) && (s_Op[s_OpCnt - 1].Op == OP_LITERAL))
+	{
+		FileNameOp_t* O = &s_Op[s_OpCnt - 1];
+		O->Str = realloc(O->Str, O->Length + Length + 1);
+		memcpy(O->Str + O->Length, Str, Length);
+		O->Length += Length;
+		O->Str[O->Length] = 0;
+		return;
+	}
+	OpAdd(OP_LITERAL, 0, Str, Length);
+}
+
+bool FileName_Compile(u8* Template)
+{
+	s_OpCnt = 0;
+
+	u8* p = Template;
+	while (*p)
+	{
+		if (p[0] == '%')
+		{
+			switch (p[1])
+			{
+			case 'Y': OpAdd(OP_YEAR,	0, NULL, 0); break;
+			case 'm': OpAdd(OP_MONTH,	0, NULL, 0); break;
+			case 'd': OpAdd(OP_DAY,		0, NULL, 0); break;
+			case 'H': OpAdd(OP_HOUR,	0, NULL, 0); break;
+			case 'M': OpAdd(OP_MIN,		0, NULL, 0); break;
+			case 'S': OpAdd(OP_SEC,		0, NULL, 0); break;
+			case 'z': OpAdd(OP_TZ,		0, NULL, 0); break;
+			case '%': OpLiteral("%", 1); break;
+			case 0:
+				fprintf(stderr, "filename template [%s] ends in %%\n", Template);
+				return false;
+
+			default:
+				{
+					// strftime conversion with any flags / width / modifier
+					u8* q = p + 1;
+					while (*q && strchr("_-0^#", *q)) q++;
+					while ((*q >= '0') && (*q <= '9')) q++;
+					if ((*q == 'E') || (*q == 'O')) q++;
+					if (*q == 0)
+					{
+						fprintf(stderr, "filename template [%s] incomplete conversion\n", Template);
+						return false;
+					}
+					OpAdd(OP_STRFTIME, 0, p, q + 1 - p);
+					p = q + 1;
+				}
+				continue;
+			}
+			p += 2;
+			continue;
+		}
+
+		if (p[0] == '{')
+		{
+			u8* End = strchr(p, '}');
+			if (!End)
+			{
+				fprintf(stderr, "filename template [%s] missing }\n", Template);
+				return false;
+			}
+
+			u8 Token[64];
+			u32 Length = End - p - 1;
+			if (Length >= sizeof(Token)) Length = sizeof(Token) - 1;
+			memcpy(Token, p + 1, Length);
+			Token[Length] = 0;
+
+			if		(strcmp(Token, "start")		== 0) OpAdd(OP_START,	1e9, NULL, 0);
+			else if (strcmp(Token, "start.ms")	== 0) OpAdd(OP_START,	1e6, NULL, 0);
+			else if (strcmp(Token, "start.us")	== 0) OpAdd(OP_START,	1e3, NULL, 0);
+			else if (strcmp(Token, "start.ns")	== 0) OpAdd(OP_START,	1,   NULL, 0);
+			else if (strcmp(Token, "end")		== 0) OpAdd(OP_END,		1e9, NULL, 0);
+			else if (strcmp(Token, "end.ms")	== 0) OpAdd(OP_END,		1e6, NULL, 0);
+			else if (strcmp(Token, "end.us")	== 0) OpAdd(OP_END,		1e3, NULL, 0);
+			else if (strcmp(Token, "end.ns")	== 0) OpAdd(OP_END,		1,   NULL, 0);
+			else if (strcmp(Token, "ms")		== 0) OpAdd(OP_FRAC,	1e6, NULL, 0);
+			else if (strcmp(Token, "us")		== 0) OpAdd(OP_FRAC,	1e3, NULL, 0);
+			else if (strcmp(Token, "ns")		== 0) OpAdd(OP_FRAC,	1,   NULL, 0);
+			else if (strcmp(Token, "seq")		== 0) OpAdd(OP_SEQ,		0,   NULL, 0);
+			else if (strcmp(Token, "hash")		== 0) OpAdd(OP_HASH,	0,   NULL, 0);
+			else if (strcmp(Token, "host")		== 0)
+			{
+				// fixed for the run
+				u8 Host[256] = { 0 };
+				gethostname(Host, sizeof(Host) - 1);
+				OpLiteral(Host, strlen(Host));
+			}
+			else
+			{
+				fprintf(stderr, "filename template [%s] unknown token {%s}\n", Template, Token);
+				return false;
+			}
+			p = End + 1;
+			continue;
+		}
+
+		// run of literal text
+		u8* Start = p;
+		while (*p && (*p != '%') && (*p != '{')) p++;
+		OpLiteral(Start, p - Start);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+
+// local time of t, only the minute and second change within a cached hour
+static void LocalTime(s64 t, struct tm* tm)
+{
+	s32 Offset	= TZ_Offset(t * (s64)k1E9) / (s64)k1E9;
+	u8* Zone	= TZ_Zone(t * (s64)k1E9);
+
+	s64 Local		= t + Offset;
+	s64 LocalHour	= Local / 3600;
+	if (LocalHour != s_Hour.Hour)
+	{
+		time_t t0 = LocalHour * 3600;
+		gmtime_r(&t0, &s_Hour.tm);
+		s_Hour.Hour = LocalHour;
+	}
+
+	*tm				= s_Hour.tm;
+	tm->tm_min		= (Local % 3600) / 60;
+	tm->tm_sec		= Local % 60;
+	tm->tm_gmtoff	= Offset;
+	tm->tm_zone		= Zone;
+}
+
+static INLINE u8* WriteDigits(u8* p, u64 Value, u32 Width)
+{
+	for (int i=Width-1; i >= 0; i--)
+	{
+		p[i] = '0' + (Value % 10);
+		Value /= 10;
+	}
+	return p + Width;
+}
+
+static INLINE u8* WriteU64(u8* p, u64 Value)
+{
+	u8 Str[24];
+	u32 Len = 0;
+	do
+	{
+		Str[Len++] = '0' + (Value % 10);
+		Value /= 10;
+	} while (Value > 0);
+
+	while (Len > 0) *p++ = Str[--Len];
+	return p;
+}
+
+void FileName_Generate(u8* FileName, u8* BaseName, u8* Suffix, u64 TS, u64 TSLast, u32 Seq)
+{
+	u32 BaseLen = strlen(BaseName);
+	memcpy(FileName, BaseName, BaseLen);
+	u8* p = FileName + BaseLen;
+
+	struct tm tm;
+	bool IsLocal = false;
+
+	for (int i=0; i < s_OpCnt; i++)
+	{
+		FileNameOp_t* O = &s_Op[i];
+
+		// local time is only needed by date ops
+		if ((O->Op >= OP_YEAR) && (O->Op <= OP_STRFTIME) && !IsLocal)
+		{
+			LocalTime(TS / (u64)1e9, &tm);
+			IsLocal = true;
+		}
+
+		switch (O->Op)
+		{
+		case OP_LITERAL:
+			memcpy(p, O->Str, O->Length);
+			p += O->Length;
+			break;
+
+		case OP_YEAR:	p = WriteDigits(p, 1900 + tm.tm_year,	4); break;
+		case OP_MONTH:	p = WriteDigits(p, 1 + tm.tm_mon,		2); break;
+		case OP_DAY:	p = WriteDigits(p, tm.tm_mday,			2); break;
+		case OP_HOUR:	p = WriteDigits(p, tm.tm_hour,			2); break;
+		case OP_MIN:	p = WriteDigits(p, tm.tm_min,			2); break;
+		case OP_SEC:	p = WriteDigits(p, tm.tm_sec,			2); break;
+
+		case OP_TZ:
+			{
+				s32 Offset = tm.tm_gmtoff;
+				*p++ = (Offset < 0) ? '-' : '+';
+				if (Offset < 0) Offset = -Offset;
+
+				p = WriteDigits(p, Offset / 3600, 2);
+				*p++ = ':';
+				p = WriteDigits(p, (Offset % 3600) / 60, 2);
+			}
+			break;
+
+		case OP_STRFTIME:
+			p += strftime(p, 256, O->Str, &tm);
+			break;
+
+		case OP_START:	p = WriteU64(p, TS / O->Div);				break;
+		case OP_END:	p = WriteU64(p, TSLast / O->Div);			break;
+		case OP_FRAC:	p = WriteDigits(p, (TS / O->Div) % 1000, 3); break;
+		case OP_SEQ:	p = WriteU64(p, Seq);						break;
+
+		case OP_HASH:
+			{
+				// murmur3 finalizer
+				u64 x = TS;
+				x ^= x >> 33;
+				x *= 0xff51afd7ed558ccdULL;
+				x ^= x >> 33;
+				x *= 0xc4ceb9fe1a85ec53ULL;
+				x ^= x >> 33;
+
+				static const u8 Hex[] = "0123456789abcdef";
+				for (int j=0; j < 8; j++) *p++ = Hex[(x >> (28 - j * 4)) & 0xf];
+			}
+			break;
+		}
+	}
+	strcpy(p, Suffix);
+}
+
+//---------------------------------------------------------------------------------------------
+// match a name against the op list, the reverse of FileName_Generate. variable length
+// fields try every length so a following op decides where they end
+
+static u32 DigitRun(u8* p, u8* End)
+{
+	u32 n = 0;
+	while ((p + n < End) && (p[n] >= '0') && (p[n] <= '9')) n++;
+	return n;
+}
+
+static bool MatchOp(u32 Index, u8* p, u8* End);
+
+static bool MatchFixed(u32 Index, u8* p, u8* End, u32 Width)
+{
+	if (DigitRun(p, End) < Width) return false;
+	return MatchOp(Index + 1, p + Width, End);
+}
+
+static bool MatchOp(u32 Index, u8* p, u8* End)
+{
+	u32 Remain = End - p;
+
+	// same generated name within a split adds .<n>
+	if (Index == s_OpCnt)
+	{
+		if (Remain == 0) return true;
+		return (Remain > 1) && (p[0] == '.') && (DigitRun(p + 1, End) == Remain - 1);
+	}
+
+	FileNameOp_t* O = &s_Op[Index];
+	switch (O->Op)
+	{
+	case OP_LITERAL:
+		if ((Remain < O->Length) || (memcmp(p, O->Str, O->Length) != 0)) return false;
+		return MatchOp(Index + 1, p + O->Length, End);
+
+	case OP_YEAR:	return MatchFixed(Index, p, End, 4);
+	case OP_MONTH:
+	case OP_DAY:
+	case OP_HOUR:
+	case OP_MIN:
+	case OP_SEC:	return MatchFixed(Index, p, End, 2);
+	case OP_FRAC:	return MatchFixed(Index, p, End, 3);
+
+	case OP_TZ:
+		if ((Remain < 6) || ((p[0] != '+') && (p[0] != '-')) || (p[3] != ':')) return false;
+		if ((DigitRun(p + 1, End) < 2) || (DigitRun(p + 4, End) < 2)) return false;
+		return MatchOp(Index + 1, p + 6, End);
+
+	case OP_HASH:
+		if (Remain < 8) return false;
+		for (int j=0; j < 8; j++)
+		{
+			bool IsHex = ((p[j] >= '0') && (p[j] <= '9')) || ((p[j] >= 'a') && (p[j] <= 'f'));
+			if (!IsHex) return false;
+		}
+		return MatchOp(Index + 1, p + 8, End);
+
+	case OP_START:
+	case OP_END:
+	case OP_SEQ:
+		for (u32 Len = DigitRun(p, End); Len > 0; Len--)
+		{
+			if (MatchOp(Index + 1, p + Len, End)) return true;
+		}
+		return false;
+
+	case OP_STRFTIME:
+		// content depends on the conversion, anything non empty
+		for (u32 Len = Remain; Len > 0; Len--)
+		{
+			if (MatchOp(Index + 1, p + Len, End)) return true;
+		}
+		return false;
+	}
+	return false;
+}
+
+bool FileName_Match(u8* Name, u32 Length)
+{
+	return MatchOp(0, Name, Name + Length);
+}
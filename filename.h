@@ -0,0 +1,33 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// split filename templates
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __FILENAME_H__
+#define __FILENAME_H__
+
+// templates for the fixed --filename-* modes
+#define FILENAME_TEMPLATE_EPOCH_SEC				"{start}"
+#define FILENAME_TEMPLATE_EPOCH_SEC_STARTEND	"{start}-{end}"
+#define FILENAME_TEMPLATE_EPOCH_MSEC			"{start.ms}"
+#define FILENAME_TEMPLATE_EPOCH_USEC			"{start.us}"
+#define FILENAME_TEMPLATE_EPOCH_NSEC			"{start.ns}"
+#define FILENAME_TEMPLATE_TSTR_HHMM				"%Y%m%d_%H%M"
+#define FILENAME_TEMPLATE_TSTR_HHMMSS			"%Y%m%d_%H%M%S"
+#define FILENAME_TEMPLATE_TSTR_HHMMSS_TZ		"%Y-%m-%d_%H:%M:%S%z"
+#define FILENAME_TEMPLATE_TSTR_HHMMSS_NS		"%Y%m%d_%H%M%S.{ms}.{us}.{ns}"
+#define FILENAME_TEMPLATE_TSTR_HHMMSS_SUB		"%Y%m%d_%H-%M-%S.{ms}{us}{ns}"
+
+// parse the template into an op list, false on a bad token
+bool				FileName_Compile	(u8* Template);
+
+// BaseName + template + Suffix. TS / TSLast are the split start / end, Seq the split number
+void				FileName_Generate	(u8* FileName, u8* BaseName, u8* Suffix, u64 TS, u64 TSLast, u32 Seq);
+
+// true if Name (without BaseName / Suffix) could have come from the template
+bool				FileName_Match		(u8* Name, u32 Length);
+
+#endif
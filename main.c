@@ -27,6 +27,21 @@
 #include <grp.h>
 
 #include "fTypes.h"
+#include "output.h"
+#include "pool.h"
+#include "reorder.h"
+#include "retain.h"
+#include "resync.h"
+#include "profile.h"
+#include "shmstats.h"
+#include "sample.h"
+#include "dedup.h"
+#include "upload.h"
+#include "compress.h"
+#include "filename.h"
+#include "tz.h"
+#include "pcapsplit.h"
+#include "plugin.h"
 
 // fmadio platform lxc_ring support
 // https://github.com/fmadio/platform 
@@ -36,22 +51,21 @@
 
 #endif
 
+// after fmadio_packet.h, which has its own pcap headers
+#include "pcapfile.h"
+
 //---------------------------------------------------------------------------------------------
 
-#define SPLIT_MODE_BYTE					1
-#define SPLIT_MODE_TIME					2
-
-#define FILENAME_EPOCH_SEC				1
-#define FILENAME_EPOCH_SEC_STARTEND		2
-#define FILENAME_EPOCH_MSEC				3
-#define FILENAME_EPOCH_USEC				4
-#define FILENAME_EPOCH_NSEC				5
-#define FILENAME_TSTR_HHMM				6
-#define FILENAME_TSTR_HHMMSS			7
-#define FILENAME_TSTR_HHMMSS_TZ			8
-#define FILENAME_TSTR_HHMMSS_NS			9
-#define FILENAME_TSTR_HHMMSS_SUB		10	
-#define FILENAME_STRFTIME				12	
+#define SPLIT_MODE_BYTE					(1<<0)
+#define SPLIT_MODE_TIME					(1<<1)
+#define SPLIT_MODE_PACKET				(1<<2)
+
+#define SPLIT_CALENDAR_NONE				0					// --split-time period aligned to the epoch
+#define SPLIT_CALENDAR_HOUR				1					// local time calendar boundaries
+#define SPLIT_CALENDAR_DAY				2
+#define SPLIT_CALENDAR_WEEK				3					// weeks start sunday
+#define SPLIT_CALENDAR_MONTH			4
+
 
 #define OUTPUT_MODE_NULL				0					// null mode for performance testing 
 #define OUTPUT_MODE_CAT					1					// cat > blah.pcap
@@ -61,86 +75,6 @@
 
 volatile bool g_SignalExit			= 0;					// signal handlered requesting exit		
 	
-//---------------------------------------------------------------------------------------------
-// pcap headers
-
-// defined in fmadio_packet.h  
-#ifndef  __FMADIO_PACKET_H__
-
-#define PCAPHEADER_MAGIC_NANO		0xa1b23c4d
-#define PCAPHEADER_MAGIC_USEC		0xa1b2c3d4
-#define PCAPHEADER_MAGIC_FMAD		0x1337bab3
-
-#define PCAPHEADER_MAJOR			2
-#define PCAPHEADER_MINOR			4
-#define PCAPHEADER_LINK_ETHERNET	1
-#define PCAPHEADER_LINK_ERF			197	
-
-typedef struct
-{
-	u32				Sec;				// time stamp sec since epoch 
-	u32				NSec;				// nsec fraction since epoch
-
-	u32				LengthCapture;		// captured length, inc trailing / aligned data
-	u32				LengthWire;			// length on the wire
-
-} __attribute__((packed)) PCAPPacket_t;
-
-// per file header
-
-typedef struct
-{
-	u32				Magic;
-	u16				Major;
-	u16				Minor;
-	u32				TimeZone;
-	u32				SigFlag;
-	u32				SnapLen;
-	u32				Link;
-
-} __attribute__((packed)) PCAPHeader_t;
-
-#endif
-
-
-// packet header
-typedef struct FMADPacket_t
-{
-	u64             TS;                     // 64bit nanosecond epoch
-
-	u32             LengthCapture   : 16;   // length captured
-	u32             LengthWire      : 16;   // Length on the wire
-
-	u32             PortNo          :  8;   // Port number
-	u32             Flag            :  8;   // flags
-	u32             pad0            : 16;
-
-} __attribute__((packed)) FMADPacket_t;
-
-#define FMAD_PACKET_FLAG_FCS		(1<<0)		// flags invalid FCS was captured 
-
-// header per packet
-typedef struct FMADHeader_t
-{
-	u16				PktCnt;					// number of packets
-	u16				CRC16;
-
-	u32				BytesWire;				// total wire bytes  
-	u32				BytesCapture;			// total capture bytes 
-	u32				Length;					// length of this block in bytes
-
-	u64				TSStart;				// TS of first packet
-	u64				TSEnd;					// TS of last packet 
-
-	// internal performance stats passed downstream
-	u64				BytePending;			// how many bytes pending 
-	u16				CPUActive;				// cpu pct stream_cat is active  
-	u16				CPUFetch;	
-	u16				CPUSend;	
-	u16				pad1;			
-
-} __attribute__((packed)) FMADHeader_t;
-
 //-------------------------------------------------------------------------------------------------
 // input mode 
 
@@ -149,8 +83,6 @@ typedef struct FMADHeader_t
 #define INPUT_MODE_FMAD		2
 #define INPUT_MODE_LXCRING	3
 
-static u8*		s_FMADChunkBuffer	= NULL;
-
 double TSC2Nano 					= 0;
 static u8 		s_FileNameSuffix[4096];			// suffix to apply to output filename
 static u8		s_strftimeFormat[1024];			// strftime format
@@ -167,6 +99,18 @@ static u8		s_SSHOpt[4096] 		= { 0 };	// ssh command options
 static u8		s_SSHHost[4096] 	= { 0 };	// ssh hostname 
 static u8		s_SSHPath[4096] 	= { 0 };	// ssh target path 
 static u8		s_SSHPrefix[4096] 	= { 0 };	// ssh filename prefix 
+static bool		s_SSHMux			= true;		// share one ssh connection between all splits
+static u8		s_SSHMuxPath[256]	= { 0 };	// control master socket, empty when not running
+
+// remote outputs written to a local spool then uploaded in the background
+static u8*		s_SpoolDir			= NULL;
+static bool		s_Spool				= false;	// spool active for this output mode
+static u8		s_SpoolURL[8192]	= { 0 };	// remote path + prefix
+static UploadConfig_t s_UploadConfig = { .WorkerCnt = 4, .RetryMax = 5, .RetryDelay = 1000 };
+
+// raw splits staged locally then run through the pipe-cmd by parallel workers
+static u32		s_CompressWorker	= 0;		// 0 for the single inline pipe
+static u8*		s_CompressStage		= NULL;		// raw split directory, default next to the output
 
 
 static u8		s_PipeCmd[4096] 	= { 0 };	// allow compression and other stuff
@@ -178,6 +122,10 @@ static u8		s_ScriptNewCmd[4096]	= { 0 };
 static bool		s_ScriptClose			= false;	// run this script when finishing a split 
 static u8		s_ScriptCloseCmd[4096]	= { 0 };
 
+// in process hooks
+static u8*		s_PluginPath			= NULL;		// --plugin shared object
+static u8*		s_PluginArg				= NULL;
+
 // chomp every packet by x bytes. used for FCS / footer removal
 static u32		s_PacketChomp			= 0;		// chomp every packet by this bytes
 
@@ -186,12 +134,195 @@ static u8*							s_LXCRingPath	= NULL;	// path to the lxc ring
 static s32							s_LXCRingFD		= 0;	// file handle
 static struct fFMADRingHeader_t* 	s_LXCRing;				// actual lxc ring struct
 
+// lxc ring backpressure. occupancy is sampled every batch of packets, crossing the high mark
+// switches to the degrade policy until it falls back under the low mark
+#define RING_SAMPLE_BATCH				1024				// packets between occupancy samples
+
+#define RING_DEGRADE_NONE				0
+#define RING_DEGRADE_SLICE				1					// header only, packets sliced to N bytes
+#define RING_DEGRADE_SAMPLE				2					// keep 1 in N packets
+
+static u32		s_RingDegradeMode			= RING_DEGRADE_NONE;
+static u32		s_RingDegradeArg			= 0;		// slice bytes / sample rate
+static float	s_RingDegradeHigh			= 75;		// pct occupancy to start degrading
+static float	s_RingDegradeLow			= 25;		// pct occupancy to stop degrading
+static bool		s_RingDegradeActive			= false;
+static u64		s_RingDegradeCnt			= 0;		// number of times degrade kicked in
+static u64		s_RingDegradePkt			= 0;		// packets sliced or sampled out
+
+static u64		s_RingOccupancy				= 0;		// last sampled entries pending
+static u64		s_RingDepth					= 0;
+static u64		s_RingHigh					= 0;		// high water mark of occupancy
+
+// output engine
+static u32		s_OutputEngine				= OUTPUT_ENGINE_PIPE;
+static u32		s_UringDepth				= 16;		// number of write buffers in flight
+static u32		s_UringBufferSize			= kMB(1);	// size of each write buffer
+static u32		s_OutputFlags				= 0;		// O_DIRECT / page cache eviction
+
+// buffer pools
+#define BATCH_BUFFER_SIZE			kMB(1)				// packet / chunk batch buffer size
+#define BATCH_BUFFER_CNT			4					// number of batch buffers
+
+static struct Pool_t*	s_PoolBatch			= NULL;		// input batch buffers
+static struct Pool_t*	s_PoolOutput		= NULL;		// io_uring write buffers
+
 // roll period
 static bool		s_RollPeriodSetup			= true;		// has the roll period been setup? only enabled if --roll-period is set
 static s64		s_RollPeriod				= 0;		// advise what the roll period is
 static s64		s_RollLocalTS				= 0;		// calculate what the start of the roll is in epoch 
 
-static s64		s_TZOffset					= 0;		// offset to local time
+
+// split config
+static u8*		s_OutFileName				= "";		// output base name
+static u32		s_SplitMode					= 0;		// SPLIT_MODE_* bitmask, rolls on whichever is hit first
+static u64		s_TargetByte				= 0;		// split every N bytes
+static u64		s_TargetPkt					= 0;		// split every N packets
+static s64		s_TargetTime				= 0;		// split every N nanos
+static s64		s_TargetTimeRoundup			= 0;		// slack before the time boundary
+static u32		s_SplitCalendar				= SPLIT_CALENDAR_NONE;
+static u8*		s_FileNameTemplate			= FILENAME_TEMPLATE_TSTR_HHMMSS;
+static u32		s_OutputMode				= OUTPUT_MODE_CAT;	// output to cat by default
+static PCAPHeader_t	s_HeaderMaster;							// master pcap header for output
+
+// run stats
+static u64		s_StartTS					= 0;		// wall time processing started
+static u64		s_TotalByte					= 0;
+static u64		s_TotalPkt					= 0;
+static u32		s_TotalSplit				= 0;
+static u64		s_LastPCAPTS				= 0;		// last packet timestamp, including NOPs
+static u64		s_LastPCAPTSCnt				= 0;		// packets seen with exactly s_LastPCAPTS
+
+// an open split
+typedef struct Split_t
+{
+	bool				IsOpen;
+	struct Output_t*	Out;								// NULL for a header only split written directly
+	u8					FileName[1024];						// filename of the final output
+	u8					FileNamePending[1024];				// filename of the currently active write
+	u8					FileNameBase[1024];					// generated name before any sequence number
+
+	u64					Byte;								// bytes written
+	u64					Pkt;								// packets written
+	u64					StartTS;							// wall time the split was opened
+	u64					StartPCAPTS;						// first packet timestamp
+
+	u64					TS;									// time boundary start. byte mode first packet
+	u64					LastTS;								// previous boundary
+	u64					NextTS;								// time boundary end
+	u32					Seq;								// splits sharing the same generated name
+	s64					InputOffset;						// input offset of the first packet, -1 when output does not map 1:1 to input
+	u64					DedupPkt;							// duplicates dropped
+
+} Split_t;
+
+static Split_t	s_Split;
+
+// gap filling
+static bool		s_SplitFill					= false;	// emit empty splits for missing time periods
+static u64		s_SplitFillMax				= 1440;		// max empty splits per gap (1 day of 1min splits)
+
+// out of order tolerance
+static s64		s_ReorderWindow				= 0;		// nanos the previous split stays open past its boundary
+static u64		s_ReorderWindowPkt			= 0;		// or number of packets
+static u32		s_ReorderBufferMax			= 0;		// reorder buffer depth in packets
+static struct Reorder_t* s_Reorder			= NULL;
+
+static Split_t	s_SplitPrev;							// previous split held open for late packets
+static u64		s_SplitPrevPktCnt			= 0;		// packets seen since it was held open
+static u64		s_SplitPrevLatePkt			= 0;		// late packets routed to it
+
+// live input with no traffic. only ring / FMAD chunked input see idle time, pcap reads block
+static s64		s_IdleFlush					= 0;		// close the split after this many nanos of wall time without packets
+static bool		s_WallClockRoll				= false;	// NOPs carry the wall clock so time splits roll while idle
+static u64		s_IdleTS					= 0;		// wall time the split last saw a packet
+static u64		s_IdlePkt					= 0;		// split packet count at that time
+static u32		s_IdleSplit					= 0;		// split number at that time
+static u64		s_IdleFlushCnt				= 0;		// splits closed by the idle timeout
+
+// checkpoint / resume
+#define RESUME_NONE						0
+#define RESUME_CONTINUE					1					// append to the pending split
+#define RESUME_FINALIZE					2					// close out the pending split, start a new one
+
+static u8*		s_CheckpointFile			= NULL;		// periodically persist progress here
+static u32		s_ResumeMode				= RESUME_NONE;
+static bool		s_InputExact				= false;	// input offset maps to written output (pcap input, no reorder buffer)
+static s64		s_InputOffset				= 0;		// input bytes consumed
+static s64		s_InputPktOffset			= -1;		// input offset of the current packet
+static s64		s_InputPushOffset			= 0;		// input bytes consumed up to the packet in the splitter
+static u64		s_ResumeSkipTS				= 0;		// non seekable input, drop packets up to this timestamp
+static u64		s_ResumeSkipCnt				= 0;		// and this many packets sharing it
+static u64		s_ResumeSkipPkt				= 0;
+
+// corrupt input resync
+#define RESYNC_BUFFER_SIZE				kMB(4)
+#define RESYNC_KEEP						(RESYNC_CHAIN * (sizeof(PCAPPacket_t) + 128*1024))	// tail a chain may not have fitted in
+
+static u64		s_ResyncMax					= 1e9;		// give up after scanning this many bytes
+static u8*		s_ResyncBuffer				= NULL;		// scan window, then pushback for the input
+static u32		s_ResyncBufferPos			= 0;		// next pushback byte
+static u32		s_ResyncBufferLen			= 0;		// end of pushback bytes
+static u64		s_ResyncCnt					= 0;		// number of resyncs
+static u64		s_ResyncByte				= 0;		// bytes skipped
+
+// instrumentation
+static bool		s_Profile					= false;	// per stage cycle counters
+static u8*		s_StatsFile					= NULL;		// json stats written with every status print
+
+// live shared memory stats
+#define STATS_SHM_BATCH					1024				// publish every this many packets
+
+static u8*		s_StatsShmPath				= NULL;
+static ShmStats_t* s_StatsShm				= NULL;
+static u64		s_DropPkt					= 0;		// packets not written to any split
+
+// rolling retention of closed splits
+static bool		s_Retain					= false;
+static RetainConfig_t s_RetainConfig;
+
+// sampling / output rate cap
+static bool		s_Sample					= false;
+static SampleConfig_t s_SampleConfig;
+
+// duplicate elimination
+static bool		s_Dedup						= false;
+static DedupConfig_t s_DedupConfig			= { .Window = 1e6, .TableSize = 1024*1024 };
+
+// per run state of the packet loop. the splitter itself is module level so there
+// is only ever the one context, shared by the cli and libpcapsplit
+#define PUSH_BATCH_MAX					64					// packets per plugin route call
+
+struct PCAPSplit_t
+{
+	bool				IsOpen;
+	u8*					Pkt;								// packets come out of the reorder buffer here
+
+	// packets read but not yet split
+	u32					BatchCnt;
+	PCAPPacket_t*		BatchPkt	[PUSH_BATCH_MAX];
+	s64					BatchTS		[PUSH_BATCH_MAX];
+	bool				BatchNOP	[PUSH_BATCH_MAX];
+	s64					BatchOffset	[PUSH_BATCH_MAX];		// s_InputPktOffset of the packet
+	s64					BatchEnd	[PUSH_BATCH_MAX];		// s_InputOffset after the packet
+	u8					BatchRoute	[PUSH_BATCH_MAX];		// PCAPSPLIT_ROUTE_*
+
+	u32					CheckpointSplit;					// split count at the last checkpoint
+	bool				IsCheckpoint;						// checkpoint due
+	bool				IsCheckpointTmp;					// snapshot written, waiting on background closes
+	u64					CheckpointCloseSeq;					// closes started before the snapshot
+	u32					StatsSplit;							// split count at the last shm publish
+	u64					StatsPktCnt;
+
+	u64					LastTSC;							// periodic status
+	u64					StatusTSC;
+	u64					LastPrintTS;
+	u64					LastPrintByte;
+	u64					LastPrintPkt;
+};
+
+static PCAPSplit_t		s_Context;
+static bool				s_ContextUsed		= false;		// options and totals are never reset, one run per process
 
 //-------------------------------------------------------------------------------------------------
 
@@ -209,10 +340,23 @@ static void Help(void)
 	printf("--cpu  <cpu id>                : bind specifically to a CPU\n");
 	printf("\n");
 	printf("--ring  <lxc_ring path>        : read data from fmadio lxc ring\n");
+	printf("--ring-degrade <slice:n|sample:n> : when the ring backs up slice packets to n bytes or keep 1 in n packets\n");
+	printf("--ring-high <pct>              : ring occupancy to start degrading (default 75)\n");
+	printf("--ring-low <pct>               : ring occupancy to stop degrading (default 25)\n");
 	printf("\n");
 	printf("-v                             : verbose output\n");
 	printf("--split-byte  <byte count>     : split by bytes\n");
 	printf("--split-time  <nanoseconds>    : split by time\n");
+	printf("--split-calendar <period>      : split on local hour / day / week / month boundaries\n");
+	printf("--split-packets <count>        : split by packet count\n");
+	printf("                               : split options can be combined, rolls on whichever is hit first\n");
+	printf("--split-time-fill              : write empty splits for time periods with no packets\n");
+	printf("--split-time-fill-max <count>  : max empty splits written for a single gap (default 1440)\n");
+	printf("--reorder-window <nanoseconds> : keep the previous time split open this long for late packets\n");
+	printf("--reorder-window-pkt <count>   : keep the previous time split open this many packets for late packets\n");
+	printf("--reorder-buffer <count>       : re-sort packets by timestamp through a buffer of this many packets\n");
+	printf("--idle-flush <nanoseconds>     : close the split after this long without packets (ring / FMAD input)\n");
+	printf("--wallclock-roll               : time splits roll on the wall clock while the input is idle\n");
 	printf("\n");
 	printf("--filename-epoch-sec           : output epoch sec  filename\n");
 	printf("--filename-epoch-sec-startend  : output epoch sec start/end filename\n");
@@ -226,14 +370,48 @@ static void Help(void)
 	printf("--filename-tstr-HHMMSS_NS      : output time string filename (Hour Min Sec Nanos)\n");
 	printf("--filename-tstr-HHMMSS_SUB     : output time string filename (Hour Min Sec Subseconds)\n");
 	printf("--filename-strftime \"string\" : output time string to strftime printed string\n");
+	printf("--filename-template \"string\" : output filename from a template, see README\n");
 	printf("\n");
 	printf("--filename-suffix              : filename suffix (default .pcap)\n");
 	printf("\n");
 	printf("--pipe-cmd                     : introduce a pipe command before final output\n");
 	printf("--rclone                       : endpoint is an rclone endpoint\n");
 	printf("--curl <args> <prefix>         : endpoint is curl\n");
+	printf("--spool <dir>                  : rclone / curl / ssh splits are written to dir, then uploaded in the background\n");
+	printf("--spool-max <bytes>            : drop the oldest waiting split when the spool is larger than this\n");
+	printf("--upload-workers <count>       : parallel background uploads (default 4)\n");
+	printf("--upload-retry <count>         : attempts per split upload (default 5)\n");
+	printf("--compress-workers <count>     : run the pipe-cmd on closed splits with this many parallel workers\n");
+	printf("--compress-stage <dir>         : directory for raw splits waiting on a compress worker\n");
 	printf("--ssh  <args> <prefix>         : endpoint is ssh\n");
+	printf("--ssh-no-mux                   : new ssh connection for every split instead of one shared connection\n");
 	printf("--null                         : null performance mode\n");
+	printf("--io-uring                     : write direct to disk using io_uring (no pipe-cmd)\n");
+	printf("--io-uring-depth <count>       : number of io_uring write buffers in flight (default 16)\n");
+	printf("--io-uring-bufsize <bytes>     : size of each io_uring write buffer (default 1MB)\n");
+	printf("--o-direct                     : io_uring output with O_DIRECT, bypassing the page cache\n");
+	printf("--drop-cache                   : io_uring output evicting the page cache behind the write head\n");
+	printf("--retain-count <count>         : keep at most this many splits, deleting the oldest\n");
+	printf("--retain-byte <bytes>          : keep at most this many bytes of splits, deleting the oldest\n");
+	printf("--retain-pct <percent>         : delete the oldest splits while the filesystem is above this usage\n");
+	printf("--retain-hook <script>         : run \"script <file>\" on expired splits instead of deleting them\n");
+	printf("--retain-recycle               : io_uring output reuses the oldest split file instead of deleting it\n");
+	printf("--resync-max <bytes>           : on a corrupt packet header scan up to this many bytes for the next valid packet (default 1e9, 0 exits)\n");
+	printf("--dedup <nanoseconds>          : drop repeats of a packet seen within this window\n");
+	printf("--dedup-table <count>          : dedup hash table entries (default 1M)\n");
+	printf("--dedup-ignore-ttl             : dedup ignoring the ip ttl / hop limit and ipv4 checksum\n");
+	printf("--sample <n>                   : write 1 in n packets\n");
+	printf("--sample-flow <n>              : write all packets of 1 in n flows (ip 5 tuple hash)\n");
+	printf("--rate-limit <bits per sec>    : cap output at this rate of capture time, excess packets are dropped\n");
+	printf("--profile                      : per stage cycle counters and write / roll latency histograms\n");
+	printf("--stats-file <file>            : write json stats with every status print\n");
+	printf("--stats-shm <file>             : publish live stats in a shared memory file (e.g /dev/shm/pcap_split)\n");
+	printf("--stats-dump <file>            : print the live stats of a running pcap_split as Prometheus text and exit\n");
+	printf("--plugin <file.so>             : load an in process plugin for packet routing / split hooks\n");
+	printf("--plugin-arg <string>          : argument passed to the plugin Open hook\n");
+	printf("--checkpoint <file>            : periodically save progress to this file\n");
+	printf("--resume                       : resume from --checkpoint appending to the pending split\n");
+	printf("--resume-finalize              : resume from --checkpoint closing out the pending split\n");
 	printf("-Z <username>                  : change ownership to username\n");
 	printf("-Z <username.group>            : change ownership to username.group\n");
 	printf("-Z <UID:GID>                   : change ownership using UID GID\n");
@@ -246,6 +424,9 @@ static void Help(void)
 	printf("example: split every 1min\n");
 	printf("$ cat my_big_capture.pcap | pcap_split -o my_big_capture_ --split-time 60e9\n");
 	printf("\n");
+	printf("example: split every 1hour capped at 50GB\n");
+	printf("$ cat my_big_capture.pcap | pcap_split -o my_big_capture_ --split-time 3600e9 --split-byte 50e9\n");
+	printf("\n");
 	printf("example: split compress pcap every 100GB\n");
 	printf("$ gzip -d -c my_big_capture.pcap.gz | pcap_split -o my_big_capture_ --split-byte 100e9\n");
 	printf("\n");
@@ -293,149 +474,49 @@ static void lsignal (int i, siginfo_t* si, void* context)
 
 
 //-------------------------------------------------------------------------------------------------
-// various different naming formats 
-static void GenerateFileName(u32 Mode, u8* FileName, u8* BaseName, u64 TS, u64 TSLast)
+// local spool file for a split that is uploaded once closed
+static void GenerateSpoolName(u8* SpoolName, u8* FileName)
 {
-	switch (Mode)
-	{
-	case FILENAME_EPOCH_SEC:
-		{
-			sprintf(FileName, "%s%lli%s", BaseName, (u64)(TS / 1e9), s_FileNameSuffix); 
-		}
-		break;
-	case FILENAME_EPOCH_SEC_STARTEND:
-		{
-			sprintf(FileName, "%s%lli-%lli%s", BaseName, (u64)(TS / 1e9), (u64)(TSLast / 1e9), s_FileNameSuffix); 
-		}
-		break;
-	case FILENAME_EPOCH_MSEC:
-		{
-			sprintf(FileName, "%s%lli%s", BaseName, (u64)(TS/1e6), s_FileNameSuffix);
-		}
-		break;
-
-	case FILENAME_EPOCH_USEC:
-		{
-			sprintf(FileName, "%s%lli%s", BaseName, (u64)(TS/1e3), s_FileNameSuffix);
-		}
-		break;
-
-	case FILENAME_EPOCH_NSEC:
-		{
-		sprintf(FileName, "%s%lli%s", BaseName, TS, s_FileNameSuffix);
-		}
-		break;
-
-	case FILENAME_TSTR_HHMM:
-		{
-			clock_date_t c	= ns2clock(TS);
-
-			u64 nsec = TS % (u64)1e9;
-
-			u64 msec = (nsec / 1e6); 
-			nsec = nsec - msec * 1e6;
-
-			u64 usec = (nsec / 1e3); 
-			nsec = nsec - usec * 1e3;
-
-			sprintf(FileName, "%s%04i%02i%02i_%02i%02i%s", BaseName, c.year, c.month, c.day, c.hour, c.min, s_FileNameSuffix);
-		}
-		break;
-
-	case FILENAME_TSTR_HHMMSS:
-		{
-			clock_date_t c	= ns2clock(TS);
-
-			sprintf(FileName, "%s%04i%02i%02i_%02i%02i%02i%s", BaseName, c.year, c.month, c.day, c.hour, c.min, c.sec, s_FileNameSuffix); 
-		}
-		break;
-
-	case FILENAME_TSTR_HHMMSS_TZ:
-		{
- 			time_t t = time(NULL);
-			struct tm lt = {0};
-     		localtime_r(&t, &lt);
-
-			s32 Offset = lt.tm_gmtoff;
-
-			u32 TZSign = '+';
-			if (Offset < 0)
-			{
-				TZSign = '-';
-				Offset = -Offset;
-			}
-			s32 TZHour = Offset/(60*60);
-			s32 TZMin  = Offset - TZHour * 60 * 60;
-
-			clock_date_t c	= ns2clock(TS);
-
-			u64 nsec = TS % (u64)1e9;
-
-			u64 msec = (nsec / 1e6); 
-			nsec = nsec - msec * 1e6;
-
-			u64 usec = (nsec / 1e3); 
-			nsec = nsec - usec * 1e3;
-
-			sprintf(FileName, "%s%04i-%02i-%02i_%02i:%02i:%02i%c%02i:%02i%s", BaseName, c.year, c.month, c.day, c.hour, c.min, c.sec, TZSign, TZHour, TZMin, s_FileNameSuffix); 
-		}
-		break;
-
-	case FILENAME_STRFTIME:
-		{
-			u8 TimeStr[1024];
-
-			time_t t0 = TS / 1e9;
-			struct tm* t = localtime(&t0);
-			strftime(TimeStr, sizeof(TimeStr), s_strftimeFormat, t);
+	u32 Len = sprintf(SpoolName, "%s/", s_SpoolDir);
 
-			sprintf(FileName, "%s%s%s", BaseName, TimeStr, s_FileNameSuffix); 
-		}
-		break;
-
-	case FILENAME_TSTR_HHMMSS_NS:
-		{
-			clock_date_t c	= ns2clock(TS);
-
-			u64 nsec = TS % (u64)1e9;
-
-			u64 msec = (nsec / 1e6); 
-			nsec = nsec - msec * 1e6;
-
-			u64 usec = (nsec / 1e3); 
-			nsec = nsec - usec * 1e3;
-
-			sprintf(FileName, "%s%04i%02i%02i_%02i%02i%02i.%03lli.%03lli.%03lli%s", BaseName, c.year, c.month, c.day, c.hour, c.min, c.sec, msec, usec, nsec, s_FileNameSuffix); 
-		}
-		break;
-
-	case FILENAME_TSTR_HHMMSS_SUB:
-		{
-			clock_date_t c	= ns2clock(TS);
-
-			u64 nsec = TS % (u64)1e9;
-
-			u64 msec = (nsec / 1e6); 
-			nsec = nsec - msec * 1e6;
-
-			u64 usec = (nsec / 1e3); 
-			nsec = nsec - usec * 1e3;
+	// flatten any directory / remote in the output name
+	for (u8* p = FileName; *p; p++)
+	{
+		SpoolName[Len++] = ((*p == '/') || (*p == ':')) ? '_' : *p;
+	}
+	SpoolName[Len] = 0;
+}
 
-			sprintf(FileName, "%s%04i%02i%02i_%02i-%02i-%02i.%03lli%03lli%03lli%s", BaseName, c.year, c.month, c.day, c.hour, c.min, c.sec, msec, usec, nsec, s_FileNameSuffix); 
-		}
-		break;
+//-------------------------------------------------------------------------------------------------
+// raw split written by the main loop when compression runs in the workers
+static void GenerateRawName(u8* RawName, u8* FileName)
+{
+	if (!s_CompressStage)
+	{
+		sprintf(RawName, "%s.raw", FileName);
+		return;
+	}
 
-	default:
-		fprintf(stderr, "unknown filename mode\n");
-		assert(false);
-		break;
+	u32 Len = sprintf(RawName, "%s/", s_CompressStage);
+	for (u8* p = FileName; *p; p++)
+	{
+		RawName[Len++] = ((*p == '/') || (*p == ':')) ? '_' : *p;
 	}
+	strcpy(RawName + Len, ".raw");
 }
 
 //-------------------------------------------------------------------------------------------------
 // generate pipe command based on config 
 static void GeneratePipeCmd(u8* Cmd, u32 Mode, u8* FileName)
 {
+	if (s_Spool)
+	{
+		u8 SpoolName[4096];
+		GenerateSpoolName(SpoolName, FileName);
+		sprintf(Cmd, "%s > '%s'", s_PipeCmd, SpoolName);
+		return;
+	}
+
 	switch (Mode)
 	{
 	case OUTPUT_MODE_NULL:
@@ -494,6 +575,18 @@ static void GenerateDescription(u8* Cmd, u32 Mode, u8* FileName)
 // rename file 
 static void RenameFile(u32 Mode, u8* FileNamePending, u8* FileName)
 {
+	// spooled splits are uploaded under the final name
+	if (s_Spool)
+	{
+		u8 SpoolPending[4096], Spool[4096];
+		GenerateSpoolName(SpoolPending, FileNamePending);
+		GenerateSpoolName(Spool, FileName);
+
+		rename(SpoolPending, Spool);
+		Upload_Queue(Spool, FileName);
+		return;
+	}
+
 	switch (Mode)
 	{
 	case OUTPUT_MODE_NULL:
@@ -533,436 +626,2664 @@ static void RenameFile(u32 Mode, u8* FileNamePending, u8* FileName)
 }
 
 //-------------------------------------------------------------------------------------------------
+// start an ssh control master so every split pipe and rename runs as a channel on one
+// connection instead of a new handshake. if the master dies ssh falls back to connecting directly
 
-int main(int argc, char* argv[])
+static void SSHMuxOpen(void)
 {
-	char* OutFileName 	= "";
+	sprintf(s_SSHMuxPath, "/tmp/pcap_split_ssh_%i.sock", getpid());
 
-	u64 TargetByte 			= 0;
-	s64 TargetTime 			= 0;
-	s64 TargetTimeRoundup	= 0;
+	u8 Cmd[8*1024];
+	sprintf(Cmd, "ssh -f -N -o ControlMaster=yes -o ControlPersist=yes -o ControlPath=%s %s %s < /dev/null", s_SSHMuxPath, s_SSHOpt, s_SSHHost);
+	printf("Cmd [%s]\n", Cmd);
 
-	u32 SplitMode			= 0;
-	u32 FileNameMode		= FILENAME_TSTR_HHMMSS;
+	if (system(Cmd) != 0)
+	{
+		fprintf(stderr, "ssh control master failed, connecting for every split\n");
+		s_SSHMuxPath[0] = 0;
+		return;
+	}
 
-	u32 CPUList[128];
-	u32 CPUListCnt		= 0;
+	// all later ssh commands go via the master
+	u32 Len = strlen(s_SSHOpt);
+	snprintf(s_SSHOpt + Len, sizeof(s_SSHOpt) - Len, " -o ControlPath=%s", s_SSHMuxPath);
+}
 
-	// default do nothing output
-	strcpy(s_PipeCmd, "cat");
+static void SSHMuxClose(void)
+{
+	if (s_SSHMuxPath[0] == 0) return;
 
+	u8 Cmd[8*1024];
+	sprintf(Cmd, "ssh -O exit %s %s 2> /dev/null", s_SSHOpt, s_SSHHost);
+	system(Cmd);
+}
 
-	// default .pcap raw
-	strcpy(s_FileNameSuffix, ".pcap");
+//-------------------------------------------------------------------------------------------------
+// compression worker callback, same as the end of SplitClose
 
-	// output to cat by default 
-	u32 OutputMode  = OUTPUT_MODE_CAT;
+static void CompressDone(u8* FileNamePending, u8* FileName)
+{
+	RenameFile(s_OutputMode, FileNamePending, FileName);
 
-	fprintf(stderr, "args\n");
-	for (int i=1; i < argc; i++)
+	if (s_FileNameUID)
 	{
-		fprintf(stderr, "  %s\n", argv[i]);
+		chown(FileName, s_FileNameUID, s_FileNameGID); 
 	}
+}
 
-	for (int i=1; i < argc; i++)
+// splits the workers have finished are only now visible to retention
+static void CompressReap(void)
+{
+	static u8 FileName[64][1024];
+
+	u32 Count;
+	while ((Count = Compress_Reap(FileName, 64)) > 0)
 	{
-		fprintf(stderr, "%s\n", argv[i]);
-		if (strcmp(argv[i], "--help") == 0)
-		{
-			Help();
-			return 0;
-		}
-		// dummy uid for analytics scripts
-		else if (strcmp(argv[i], "--uid") == 0)
-		{
-			u8* UID = argv[i+1];
-			i++;
-			fprintf(stderr, "    UID [%s]\n", UID);
-		}
-		else if (strcmp(argv[i], "-o") == 0)
-		{
-			OutFileName = argv[i+1];
-			fprintf(stderr, "    OutputName [%s]\n", OutFileName);
-			i++;
-		}
+		if (!s_Retain) continue;
 
-		// parse a list of avaliable CPUs
-		else if (strcmp(argv[i], "--cpu") == 0)
-		{
-			u8* CPUStr   = argv[i+1];
-			u32 CPUStrLen = strlen(CPUStr);
-			u8* CPUStart = CPUStr; 
-			for (int i=0; i <= CPUStrLen; i++)
-			{
-				if ((CPUStr[i] == ',') || (CPUStr[i] == 0))
-				{
-					CPUStr[i] = 0;
+		for (int i=0; i < Count; i++) Retain_Add(FileName[i]);
+		Retain_Check();
+	}
+}
 
-					u32 CPU = atoi(CPUStart);
-					CPUList[CPUListCnt++] = CPU;
+//-------------------------------------------------------------------------------------------------
+// a closed split waiting for its output to complete. the split itself is reused straight
+// away so everything the close hooks need is copied here
 
-					fprintf(stderr, "CPU [%i]\n", CPU);
-					CPUStart = &CPUStr[i+1];
-				}
-			}
+typedef struct SplitDone_t
+{
+	u8					FileName[1024];
+	u8					FileNamePending[1024];
+	u8					Script[4096];						// close script, empty for none
+	u64					Byte;
+	u64					Pkt;
 
-			i++;
-			fprintf(stderr, "    CPUList Cnt:%i [", CPUListCnt);
-			for (int i=0; i < CPUListCnt; i++)
-			{
-				fprintf(stderr, "%i ", CPUList[i]);
-			}
-			fprintf(stderr, "]\n", CPUList[i]);
-		}
-		else if (strcmp(argv[i], "--ring") == 0)
-		{
-			#ifndef FMADIO_LXCRING
-				fprintf(stderr, "ERROR: LXC Ring support not comipled in\n");
-				assert (false);
-			#endif
+} SplitDone_t;
 
-			s_LXCRingPath = argv[i+1];
-			fprintf(stderr, "    Input from lxc_ring:%s\n", s_LXCRingPath);
-			i++;
-		}
-		else if (strcmp(argv[i], "--split-byte") == 0)
-		{
-			SplitMode = SPLIT_MODE_BYTE; 
+// output is complete. run the close hooks then rename .pending to the final name
+static void SplitCloseDone(void* User, int Result)
+{
+	SplitDone_t* D = (SplitDone_t*)User;
 
-			TargetByte = atof(argv[i+1]);
-			i++;
+	u64 HookTSC = g_ProfileEnable ? rdtsc() : 0;
 
-			fprintf(stderr, "    Split Every %lli Bytes %.3f GByte\n", TargetByte, TargetByte / (double)kGB(1));
-		}
-		else if (strcmp(argv[i], "--split-time") == 0)
-		{
-			SplitMode = SPLIT_MODE_TIME; 
+	// with compress workers the file only exists once its worker is done, it runs the script
+	if ((D->Script[0] != 0) && !s_CompressWorker)
+	{
+		printf("Script [%s]\n", D->Script);
+		system(D->Script);
+	}
+	if (s_PluginPath) Plugin_SplitClose(D->FileName, D->Byte, D->Pkt);
 
-			TargetTime = atof(argv[i+1]);
-			i++;
+	// raw split goes to a worker, which runs the pipe command and renames
+	if (s_CompressWorker)
+	{
+		u8 RawName[4096], PipeCmd[16*1024];
+		GenerateRawName(RawName, D->FileNamePending);
+		GeneratePipeCmd(PipeCmd, s_OutputMode, D->FileNamePending);
 
-			fprintf(stderr, "    Split Every %f Sec\n", TargetTime / 1e9);
-		}
-		else if (strcmp(argv[i], "--split-time-roundup") == 0)
-		{
-			TargetTimeRoundup  = atof(argv[i+1]);
-			i++;
+		Compress_Queue(RawName, PipeCmd, D->FileNamePending, D->FileName, (D->Script[0] != 0) ? D->Script : NULL);
 
-			fprintf(stderr, "    Split Foundup %.6fsec\n", TargetTimeRoundup / 1e9);
-		}
-		else if (strcmp(argv[i], "--packet-chomp") == 0)
+		if (g_ProfileEnable) Profile_Add(PROFILE_HOOK, rdtsc() - HookTSC);
+		free(D);
+		return;
+	}
+
+	// rename to file name 
+	RenameFile(s_OutputMode, D->FileNamePending, D->FileName);
+
+	if (g_ProfileEnable) Profile_Add(PROFILE_HOOK, rdtsc() - HookTSC);
+
+	// change owner
+	if (s_FileNameUID)
+	{
+		chown(D->FileName, s_FileNameUID, s_FileNameGID); 
+	}
+
+	// expire the oldest splits
+	if (s_Retain)
+	{
+		Retain_Add(D->FileName);
+		Retain_Check();
+	}
+	free(D);
+}
+
+//-------------------------------------------------------------------------------------------------
+// finish a split. the close hooks and rename run once its output is complete, for io_uring
+// that is after the final fdatasync which does not hold up the next split
+// PCAPTS is the timestamp that caused the close (last packet for the final close)
+
+static void SplitClose(Split_t* S, s64 PCAPTS, bool IsFinal)
+{
+	if (!S->IsOpen) return;
+	S->IsOpen = false;
+
+	// compression workers finished some earlier splits
+	if (s_CompressWorker) CompressReap();
+
+	u64 TS = clock_ns();
+
+	// log the number of packets and total size
+	double dT = (TS - s_StartTS) / 1e9;
+	u8 TimeStr[1024];
+	clock_date_t c	= ns2clock(PCAPTS);
+	sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
+
+	s64 SplitDT 		= TS - S->StartTS; 
+	s64 SplitPCAPDT 	= PCAPTS - S->StartPCAPTS; 
+
+	u8 DedupStr[128] = { 0 };
+	if (s_Dedup) sprintf(DedupStr, " Dedup Pkts:%lli", S->DedupPkt);
+
+	printf("[%.3f H][%s] %s : Finished : Split Bytes %16lli (%.3f GB) Split Pkts:%10lli WallTime:%20lli PCAPTime:%20lli%s%s\n", dT / (60*60), TimeStr, S->FileName, S->Byte, S->Byte / 1e9, S->Pkt, SplitDT, SplitPCAPDT, DedupStr, IsFinal ? " close" : "");
+
+	SplitDone_t* D = calloc(1, sizeof(SplitDone_t));
+	assert(D != NULL);
+
+	strcpy(D->FileName,			S->FileName);
+	strcpy(D->FileNamePending,	S->FileNamePending);
+	D->Byte	= S->Byte;
+	D->Pkt	= S->Pkt;
+
+	// local script for every closed split
+	u8* Cmd = D->Script;
+	if (s_ScriptClose)
+	{
+
+		// byte / packet splits pass the output description
+		if (!(s_SplitMode & SPLIT_MODE_TIME) && !IsFinal)
 		{
-			s_PacketChomp = atof(argv[i+1]);
-			i++;
-			fprintf(stderr, "    chomp every packet by %i bytes\n", s_PacketChomp);
+			// filename description
+			u8 Desc[4096];
+			GenerateDescription(Desc, s_OutputMode, S->FileName);
+
+			sprintf(Cmd, "%s \"%s\" %lli %lli %lli %lli %lli %lli",  	s_ScriptCloseCmd,
+																		Desc,
+																		S->Byte,
+																		S->Pkt,
+																		SplitDT,
+																		SplitPCAPDT,
+																		S->TS,
+																		s_LastPCAPTS
+			);
 		}
-		else if (strcmp(argv[i], "--roll-period") == 0)
+		else
 		{
-			s_RollPeriodSetup = false;
-			s_RollPeriod = atof(argv[i+1]);
-			i++;
-			fprintf(stderr, "    Roll Period %.3f hours\n", s_RollPeriod/(60*60*1e9) );
+			sprintf(Cmd, "%s %s %lli %lli %lli %lli %lli %lli %lli %lli %lli",
+																s_ScriptCloseCmd,
+																S->FileName,
+
+																S->Byte,
+																S->Pkt,
+
+																SplitDT,
+																SplitPCAPDT,
+
+																S->LastTS,
+																S->TS,
+
+																S->StartPCAPTS,
+																s_LastPCAPTS,
+
+																PCAPTS
+			);
 		}
-		else if (strcmp(argv[i], "--filename-epoch-sec") == 0)
+	}
+
+	if (S->Out)
+	{
+		Output_Close(S->Out, SplitCloseDone, D);
+		S->Out = NULL;
+	}
+	else
+	{
+		SplitCloseDone(D, 0);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// start a new split. FileTS / FileTSLast are the timestamps the filename is generated from
+// IsEmpty splits are header only, written directly when there is no pipe command to run
+
+static bool SplitOpen(Split_t* S, s64 PCAPTS, u64 FileTS, u64 FileTSLast, bool IsEmpty)
+{
+	// run local new script 
+	if (s_ScriptNew)
+	{
+		printf("Script [%s]\n", s_ScriptNewCmd);
+
+		u64 HookTSC = g_ProfileEnable ? rdtsc() : 0;
+		system(s_ScriptNewCmd);
+		if (g_ProfileEnable) Profile_Add(PROFILE_HOOK, rdtsc() - HookTSC);
+	}
+
+	u8 FileNameBase[1024];
+	FileName_Generate(FileNameBase, s_OutFileName, s_FileNameSuffix, FileTS, FileTSLast, s_TotalSplit);
+
+	// same name as the previous split (e.g byte cap hit within a time split) add a sequence number
+	if (strcmp(FileNameBase, S->FileNameBase) == 0)
+	{
+		S->Seq++;
+
+		u32 Len = strlen(FileNameBase) - strlen(s_FileNameSuffix);
+		memcpy(S->FileName, FileNameBase, Len);
+		sprintf(S->FileName + Len, ".%i%s", S->Seq, s_FileNameSuffix);
+	}
+	else
+	{
+		S->Seq = 0;
+		strcpy(S->FileNameBase, FileNameBase);
+		strcpy(S->FileName, FileNameBase);
+	}
+	sprintf(S->FileNamePending, "%s.pending", S->FileName);
+
+	if (IsEmpty && (s_OutputMode == OUTPUT_MODE_CAT) && (strcmp(s_PipeCmd, "cat") == 0))
+	{
+		int fd = open(S->FileNamePending, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+		if (fd < 0)
 		{
-			fprintf(stderr, "    Filename EPOCH Sec\n");
-			FileNameMode	= FILENAME_EPOCH_SEC;
+			printf("OutputFilename is invalid [%s] %i %s\n", S->FileName, errno, strerror(errno));
+			return false;
 		}
-		else if (strcmp(argv[i], "--filename-epoch-sec-startend") == 0)
+		write(fd, &s_HeaderMaster, sizeof(s_HeaderMaster));
+		close(fd);
+
+		S->Out = NULL;
+	}
+	else
+	{
+		// generate pipe
+		u8 Cmd[16*1024];
+		GeneratePipeCmd(Cmd, s_OutputMode, S->FileNamePending);
+
+		// write the raw split, the pipe command runs in a worker once its closed
+		u8 RawName[4096];
+		u8* OutName = S->FileNamePending;
+		if (s_CompressWorker)
 		{
-			fprintf(stderr, "    Filename EPOCH Sec Start/End\n");
-			FileNameMode	= FILENAME_EPOCH_SEC_STARTEND;
+			GenerateRawName(RawName, S->FileNamePending);
+			sprintf(Cmd, "cat > '%s'", RawName);
+			OutName = RawName;
 		}
-		else if (strcmp(argv[i], "--filename-epoch-msec") == 0)
+		printf("[%s]\n", Cmd);
+
+		// reuse the oldest split when at the retention limit
+		bool IsReuse = s_Retain && !s_CompressWorker && Retain_Recycle(S->FileNamePending);
+
+		S->Out = Output_Open(Cmd, OutName, IsReuse ? OUTPUT_OPEN_REUSE : 0);
+		if (!S->Out)
 		{
-			fprintf(stderr, "    Filename EPOCH MSec\n");
-			FileNameMode	= FILENAME_EPOCH_MSEC;
+			printf("OutputFilename is invalid [%s] %i %s\n", S->FileName, errno, strerror(errno));
+			return false;
 		}
-		else if (strcmp(argv[i], "--filename-epoch-usec") == 0)
+
+		//write pcap header
+		Output_Write(S->Out, &s_HeaderMaster, sizeof(s_HeaderMaster));
+		Output_Flush(S->Out);
+	}
+	S->IsOpen		= true;
+
+	S->Byte			= 0;
+	S->Pkt			= 0;
+	S->DedupPkt		= 0;
+	S->StartTS		= clock_ns();
+	S->StartPCAPTS	= PCAPTS;
+	S->InputOffset	= IsEmpty ? -1 : s_InputPktOffset;
+
+	s_TotalSplit++;
+
+	if (s_PluginPath) Plugin_SplitOpen(S->FileName, FileTS);
+
+	u8 TimeStr[1024];
+	clock_date_t c	= ns2clock(PCAPTS);
+	sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
+
+	double dT = (clock_ns() - s_StartTS) / 1e9;
+	double Bps = (s_TotalByte * 8.0) / dT; 
+	printf("[%.3f H][%s] %s : Total Bytes %.3f GB Speed: %.3f Gbps : New Split\n", dT / (60*60), TimeStr, S->FileName, s_TotalByte / 1e9, Bps / 1e9);
+	fflush(stdout);
+	fflush(stderr);
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// time split boundaries. calendar boundaries are in local time, worked out once per split
+// so the per packet check stays a compare against NextTS
+
+static u64 SplitTimeStart(u64 TS)
+{
+	if (s_SplitCalendar == SPLIT_CALENDAR_NONE) return (TS / s_TargetTime) * s_TargetTime;
+
+	// hours are the same length in local time, only the offset is needed
+	s64 Local = TS + TZ_Offset(TS);
+	u64 Start = TS - (Local % (3600 * k1E9));
+	if (s_SplitCalendar == SPLIT_CALENDAR_HOUR) return Start;
+
+	clock_date_t c	= ns2clock(TS);
+	c.hour			= 0;
+	c.min			= 0;
+	c.sec			= 0;
+	if (s_SplitCalendar == SPLIT_CALENDAR_WEEK)		c = clock_startofweek(c);
+	if (s_SplitCalendar == SPLIT_CALENDAR_MONTH)	c.day = 1;
+
+	// local midnight missing on a DST change, use the start of the hour
+	u64 DayStart = clock_date2ns(c);
+	return (DayStart <= TS) ? DayStart : Start;
+}
+
+static u64 SplitTimeNext(u64 TS)
+{
+	if (s_SplitCalendar == SPLIT_CALENDAR_NONE) return TS + s_TargetTime;
+	if (s_SplitCalendar == SPLIT_CALENDAR_HOUR) return TS + 3600 * k1E9;
+
+	// mktime normalizes day 32 / month 13 into the next month / year
+	clock_date_t c	= ns2clock(TS);
+	switch (s_SplitCalendar)
+	{
+	case SPLIT_CALENDAR_DAY:	c.day	+= 1; break;
+	case SPLIT_CALENDAR_WEEK:	c.day	+= 7; break;
+	case SPLIT_CALENDAR_MONTH:	c.month	+= 1; break;
+	}
+
+	// never stall on a boundary that does not move forward
+	u64 Next = clock_date2ns(c);
+	return (Next > TS) ? Next : TS + 3600 * k1E9;
+}
+
+//-------------------------------------------------------------------------------------------------
+// header only splits for every time boundary skipped between two splits
+// so downstream sees one file per period even when there was no traffic
+
+static void SplitFillGap(u64 LastTS, u64 NextTS)
+{
+	if ((LastTS == 0) || (NextTS <= SplitTimeNext(LastTS))) return;
+
+	u64 MissingCnt = 0;
+	if (s_SplitCalendar == SPLIT_CALENDAR_NONE)
+	{
+		MissingCnt = (NextTS - LastTS) / s_TargetTime - 1;
+	}
+	else
+	{
+		for (u64 TS = SplitTimeNext(LastTS); (TS < NextTS) && (MissingCnt <= s_SplitFillMax); TS = SplitTimeNext(TS)) MissingCnt++;
+	}
+	if (MissingCnt > s_SplitFillMax)
+	{
+		printf("gap of %lli splits %s -> %s exceeds fill max %lli, not filling\n", MissingCnt, FormatTS(LastTS), FormatTS(NextTS), s_SplitFillMax);
+		return;
+	}
+
+	for (u64 TS = SplitTimeNext(LastTS); TS < NextTS; TS = SplitTimeNext(TS))
+	{
+		Split_t S;
+		memset(&S, 0, sizeof(S));
+
+		u64 TSEnd = SplitTimeNext(TS);
+		if (!SplitOpen(&S, TS, TS, TSEnd, true)) break;
+
+		S.LastTS	= TS;
+		S.TS		= TSEnd;
+		SplitClose(&S, TSEnd, false);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// called on NOP packets only, so the wall clock is not read per packet. closes the current
+// split once it has gone --idle-flush without a packet, the next packet opens a new one
+
+static void SplitIdle(void)
+{
+	if (!s_Split.IsOpen) return;
+
+	u64 Now = clock_ns();
+	if ((s_Split.Pkt != s_IdlePkt) || (s_TotalSplit != s_IdleSplit) || (s_IdleTS == 0))
+	{
+		s_IdleTS	= Now;
+		s_IdlePkt	= s_Split.Pkt;
+		s_IdleSplit	= s_TotalSplit;
+		return;
+	}
+	if (Now - s_IdleTS < s_IdleFlush) return;
+
+	printf("idle for %.3f sec, closing split\n", (Now - s_IdleTS) / 1e9);
+	SplitClose(&s_Split, s_LastPCAPTS, false);
+	s_IdleFlushCnt++;
+	s_IdleTS		= 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+// split decision and output for a single packet. IsRollRequest is the plugin routing this
+// packet to a new split, ignored if the packet is dropped. returns false on a fatal output error
+
+static bool SplitPacket(s64 PCAPTS, PCAPPacket_t* PktHeader, bool IsRollRequest)
+{
+	// resume needs to know how far into the last timestamp the input got
+	if (PCAPTS != s_LastPCAPTS) s_LastPCAPTSCnt = 0;
+	if (PktHeader->LengthWire > 0) s_LastPCAPTSCnt++;
+
+	// repeat of a recent packet, carry on as a NOP so time splits still advance
+	bool IsDup = false;
+	if (s_Dedup && (PktHeader->LengthWire > 0))
+	{
+		if (Dedup_Packet(PCAPTS, (u8*)(PktHeader + 1), PktHeader->LengthCapture))
 		{
-			fprintf(stderr, "    Filename EPOCH Micro Sec\n");
-			FileNameMode	= FILENAME_EPOCH_USEC;
+			PktHeader->LengthWire		= 0;
+			PktHeader->LengthCapture	= 0;
+			s_DropPkt++;
+			IsDup = true;
 		}
-		else if (strcmp(argv[i], "--filename-epoch-nsec") == 0)
+	}
+
+	// sampled out / over the rate cap
+	if (s_Sample && (PktHeader->LengthWire > 0))
+	{
+		if (!Sample_Packet(PCAPTS, (u8*)(PktHeader + 1), PktHeader->LengthCapture, sizeof(PCAPPacket_t) + PktHeader->LengthCapture - s_PacketChomp))
 		{
-			fprintf(stderr, "    Filename EPOCH nano Sec\n");
-			FileNameMode	= FILENAME_EPOCH_NSEC;
+			PktHeader->LengthWire		= 0;
+			PktHeader->LengthCapture	= 0;
+			s_DropPkt++;
 		}
-		else if (strcmp(argv[i], "--filename-tstr-HHMM") == 0)
+	}
+
+	// init the roll period
+	if (!s_RollPeriodSetup)
+	{
+		s_RollPeriodSetup = true;
+
+		// calcuclate pct within the roll the packet is
+		//s64 PktRollModulo = PCAPTS %  s_RollPeriod;
+		//float Pct = PktRollModulo / (float)s_RollPeriod;
+		//printf("roll period setup:%.3fmin  Nano Modulo:%lli Pct%:%.3f FirstPkt:%s\n", s_RollPeriod/60e9, PktRollModulo, Pct, FormatTS(PCAPTS));
+
+		// calculat the next roll time. by adding 10% of the roll period (if pkts are slightly before roll time)
+		// to the packet time and rounding up
+		s_RollLocalTS = (PCAPTS + 0.10 * s_RollPeriod + TZ_Offset(PCAPTS)) / s_RollPeriod;
+		s_RollLocalTS += 1; 
+		s_RollLocalTS *= s_RollPeriod; 
+
+		printf("RollTime: %lli %s\n", s_RollLocalTS, FormatTS(s_RollLocalTS));
+	}
+
+	// previous split is still open inside the reorder window
+	Split_t* S = &s_Split;
+	if (s_SplitPrev.IsOpen)
+	{
+		s_SplitPrevPktCnt++;
+
+		// late packet, timestamp belongs to the previous split
+		if ((PCAPTS >= s_SplitPrev.LastTS) && (PCAPTS < s_SplitPrev.TS))
 		{
-			fprintf(stderr, "    Filename TimeString HHMM\n");
-			FileNameMode	= FILENAME_TSTR_HHMM;
+			S = &s_SplitPrev;
+			s_SplitPrevLatePkt++;
 		}
-		else if (strcmp(argv[i], "--filename-tstr-HHMMSS") == 0)
+		// window has passed
+		else if (((s_ReorderWindow > 0) && (PCAPTS >= s_SplitPrev.TS + s_ReorderWindow)) ||
+				 ((s_ReorderWindowPkt > 0) && (s_SplitPrevPktCnt >= s_ReorderWindowPkt)))
 		{
-			fprintf(stderr, "    Filename TimeString HHMMSS\n");
-			FileNameMode	= FILENAME_TSTR_HHMMSS;
+			printf("reorder window closed. late packets %lli\n", s_SplitPrevLatePkt);
+			SplitClose(&s_SplitPrev, PCAPTS, false);
 		}
-		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_TZ") == 0)
+	}
+
+	// split decision, roll on whichever of time / bytes / packets is hit first
+	bool IsTimeRoll		= false;
+	bool IsRoll			= false;
+
+	if ((s_SplitMode & SPLIT_MODE_TIME) && (S == &s_Split))
+	{
+		bool IsNoSplit = false;
+
+		//if it has a roll position
+		if (s_RollLocalTS != 0)
 		{
-			fprintf(stderr, "    Filename TimeString HHMMSS_TZ\n");
-			FileNameMode	= FILENAME_TSTR_HHMMSS_TZ;
+			// position wrt to split time
+			float Pct = (s_RollLocalTS - (PCAPTS + TZ_Offset(PCAPTS))) / (float)s_RollPeriod;
+
+			// overflow into the next split
+			if (Pct <= 0.0)
+			{
+				static u64 DisablePktCnt = 0;
+
+				//dont split let the packets bleed over
+				IsNoSplit = true;
+
+				// log only the first 10K disables 
+				DisablePktCnt++;
+				if (DisablePktCnt < 10000)
+				{
+					printf("Disable splitter:%f : %lli %lli %lli\n", Pct, s_RollLocalTS,  (PCAPTS + TZ_Offset(PCAPTS)), s_RollPeriod, DisablePktCnt);
+				}
+			}
 		}
 
-		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_NS") == 0)
+		// if pcap time is over the split 
+		// or the pcap time has jumped back negative substanially
+		s64 dTS = PCAPTS - s_Split.TS;
+		if (s_SplitCalendar != SPLIT_CALENDAR_NONE)
 		{
-			fprintf(stderr, "    Filename TimeString HHMMSS Nano\n");
-			FileNameMode	= FILENAME_TSTR_HHMMSS_NS;
+			// past the boundary, or jumped back more than a period
+			s64 Period = s_Split.NextTS - s_Split.TS;
+			if (((PCAPTS >= s_Split.NextTS) || (dTS < -Period)) && (!IsNoSplit))
+			{
+				IsTimeRoll = true;
+			}
 		}
-		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_SUB") == 0)
+		else if (((dTS > s_TargetTime) || (dTS < -s_TargetTime))  && (!IsNoSplit))
 		{
-			fprintf(stderr, "    Filename TimeString HHMMSS Subseconds\n");
-			FileNameMode	= FILENAME_TSTR_HHMMSS_SUB;
+			IsTimeRoll = true;
 		}
-		else if (strcmp(argv[i], "--filename-strftime") == 0)
+	}
+	if ((s_SplitMode & SPLIT_MODE_BYTE) && (S->Byte > s_TargetByte))
+	{
+		IsRoll = true;
+	}
+	if ((s_SplitMode & SPLIT_MODE_PACKET) && (S->Pkt >= s_TargetPkt))
+	{
+		IsRoll = true;
+	}
+	// plugin routed the packet to a new split
+	if (IsRollRequest && (PktHeader->LengthWire > 0))
+	{
+		IsRoll = true;
+	}
+	// resumed after finalizing the pending split, or closed by --idle-flush
+	// a NOP only re-opens it when there is nothing to idle flush
+	if ((S == &s_Split) && !s_Split.IsOpen && ((PktHeader->LengthWire > 0) || (s_IdleFlush == 0)))
+	{
+		IsRoll = true;
+	}
+
+	u64 RollTSC = (g_ProfileEnable && (IsTimeRoll || IsRoll)) ? rdtsc() : 0;
+
+	if (IsTimeRoll)
+	{
+		// save previous boundary
+		s_Split.LastTS = s_Split.TS;
+
+		// round up the last 1/XXX (default 4) of the time target
+		// this can be overwriten with --split-time-roundup  
+		// as the capture processes does not split preceisely at 0.00000000000
+		// thus allow for some variance
+		s_Split.TS		= SplitTimeStart(PCAPTS + s_TargetTimeRoundup);
+		s_Split.NextTS	= SplitTimeNext(s_Split.TS);
+
+		// close file and rename, or hold it open for late packets
+		if ((s_ReorderWindow > 0) || (s_ReorderWindowPkt > 0))
 		{
-			FileNameMode	= FILENAME_STRFTIME;
-			strncpy(s_strftimeFormat, argv[i+1], sizeof(s_strftimeFormat));
+			if (s_SplitPrev.IsOpen) printf("reorder window closed. late packets %lli\n", s_SplitPrevLatePkt);
+			SplitClose(&s_SplitPrev, PCAPTS, false);
 
-			fprintf(stderr, "    Filename TimeString (%s)\n", s_strftimeFormat);
-			i++;
+			s_SplitPrev			= s_Split;
+			s_SplitPrevPktCnt	= 0;
+			s_SplitPrevLatePkt	= 0;
+
+			s_Split.IsOpen		= false;
+			s_Split.Out			= NULL;
 		}
-		else if (strcmp(argv[i], "--pipe-cmd") == 0)
+		else
 		{
-			strncpy(s_PipeCmd, argv[i+1], sizeof(s_PipeCmd));	
-			fprintf(stderr, "    pipe cmd [%s]\n", s_PipeCmd);
-			i++;
+			SplitClose(&s_Split, PCAPTS, false);
 		}
-		else if (strcmp(argv[i], "--filename-suffix") == 0)
+
+		// create null PCAPs for anything missing 
+		if (s_SplitFill) SplitFillGap(s_Split.LastTS, s_Split.TS);
+
+		// generate filename for output
+		u64 SplitTSStart 	= s_Split.TS;
+		u64 SplitTSStop		= s_Split.NextTS;
+
+		if (!SplitOpen(&s_Split, PCAPTS, SplitTSStart, SplitTSStop, false)) return false;
+
+		// fresh split, byte / packet caps start again
+		IsRoll = false;
+	}
+	else if (IsRoll)
+	{
+		// late packets never start a new split
+		if (S != &s_Split) IsRoll = false;
+	}
+	if (IsRoll)
+	{
+		SplitClose(&s_Split, PCAPTS, false);
+
+		// byte / packet cap hit inside a time split, keep the boundary
+		if (s_SplitMode & SPLIT_MODE_TIME)
 		{
-			strncpy(s_FileNameSuffix, argv[i+1], sizeof(s_FileNameSuffix));	
-			fprintf(stderr, "    Filename Suffix [%s]\n", s_FileNameSuffix);
-			i++;
+			if (!SplitOpen(&s_Split, PCAPTS, PCAPTS, s_Split.NextTS, false)) return false;
 		}
-		else if (strcmp(argv[i], "--rclone") == 0)
+		else
 		{
-			OutputMode = OUTPUT_MODE_RCLONE;
-			fprintf(stderr, "    Output Mode RClone\n");
+			if (!SplitOpen(&s_Split, PCAPTS, PCAPTS, s_Split.TS, false)) return false;
+			s_Split.TS = PCAPTS;
 		}
-		else if (strcmp(argv[i], "--curl") == 0)
+	}
+	if (RollTSC != 0)
+	{
+		u64 dTSC = rdtsc() - RollTSC;
+		Profile_Add(PROFILE_ROLL, dTSC);
+		Profile_Hist(PROFILE_HIST_ROLL, dTSC);
+	}
+
+	//if its a valid packet (e.g dont write NOP packets to disk)
+	if (PktHeader->LengthWire > 0)
+	{
+		// optionally chomp packets before outputing
+		PktHeader->LengthWire		-= s_PacketChomp; 
+		PktHeader->LengthCapture	-= s_PacketChomp; 
+
+		// write output
+		u64 WriteTSC = g_ProfileEnable ? rdtsc() : 0;
+		int wlen = Output_Write(S->Out, PktHeader, sizeof(PCAPPacket_t) + PktHeader->LengthCapture);
+		if (g_ProfileEnable)
 		{
-			strncpy(s_CURLArg , 	argv[i+1], sizeof(s_CURLArg)	);	
-			strncpy(s_CURLPath, 	argv[i+2], sizeof(s_CURLPath)	);	
+			u64 dTSC = rdtsc() - WriteTSC;
+			Profile_Add(PROFILE_WRITE, dTSC);
+			Profile_Hist(PROFILE_HIST_WRITE, dTSC);
+		}
+		if (wlen != sizeof(PCAPPacket_t) + PktHeader->LengthCapture)
+		{
+			printf("write failure. possibly out of disk space\n");
 
-			// seperate the path from the filename prefix 
-			for (int i=strlen(s_CURLPath)-1; i >= 0; i--)
-			{
-				if (s_CURLPath[i] == '/')
-				{
-					printf("copy %i %i %s\n", i, strlen(s_CURLPath), s_CURLPath ); 
+			// free the oldest split and continue in a new one
+			if (!s_Retain || !Retain_Reclaim()) return false;
 
-					int Pos = 0;
-					for (int j=i+1; j < strlen(s_CURLPath); j++)
-					{
-						s_CURLPrefix[Pos++] = s_CURLPath[j];	
-					}
-					s_CURLPrefix[Pos++] = 0;
+			SplitClose(S, PCAPTS, false);
 
-					// drop the filename prefix
-					s_CURLPath[i+1] = 0;
-					break;
-				}
+			// late packets are dropped rather than re-opening the previous period
+			if (S != &s_Split)
+			{
+				s_DropPkt++;
+				return true;
 			}
 
-			OutputMode = OUTPUT_MODE_CURL;
-			fprintf(stderr, "    Output Mode CURL (%s) (%s) (%s)\n", s_CURLArg, s_CURLPath, s_CURLPrefix);
-			i += 2;
-		}
-		else if (strcmp(argv[i], "--ssh") == 0)
-		{
-			strncpy(s_SSHArg , 	argv[i+1], sizeof(s_SSHArg)	);	
+			// same as a byte / packet roll
+			if (s_SplitMode & SPLIT_MODE_TIME)
+			{
+				if (!SplitOpen(&s_Split, PCAPTS, PCAPTS, s_Split.NextTS, false)) return false;
+			}
+			else
+			{
+				if (!SplitOpen(&s_Split, PCAPTS, PCAPTS, s_Split.TS, false)) return false;
+				s_Split.TS = PCAPTS;
+			}
 
-			// seperate the path from the filename prefix 
-			u32 PrefixStart = 0;
-			for (int i=strlen(s_SSHArg)-1; i >= 0; i--)
+			wlen = Output_Write(S->Out, PktHeader, sizeof(PCAPPacket_t) + PktHeader->LengthCapture);
+			if (wlen != sizeof(PCAPPacket_t) + PktHeader->LengthCapture)
 			{
-				if (s_SSHArg[i] == '/')
-				{
-					PrefixStart = i;
-					//printf("copy %i %i %s\n", i, strlen(s_SSHArg), s_SSHArg ); 
+				printf("write failure after reclaim\n");
+				return false;
+			}
+		}
 
-					int Pos = 0;
-					for (int j=i+1; j < strlen(s_SSHArg); j++)
-					{
-						s_SSHPrefix[Pos++] = s_SSHArg[j];	
-					}
-					s_SSHPrefix[Pos++] = 0;
-					assert(Pos < sizeof(s_SSHPrefix));
+		S->Byte += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
+		S->Pkt  += 1; 
 
-					// drop the filename prefix
-					s_SSHPath[i+1] = 0;
-					break;
-				}
-			}
+		s_TotalByte += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
+		s_TotalPkt  += 1; 
+	}	
+	else
+	{
+		// input skipped, file offsets no longer map to the input
+		S->InputOffset = -1;
+		if (IsDup) S->DedupPkt++;
+	}
+	// use the NOP packets to update the timestamp
+	s_LastPCAPTS = PCAPTS;
 
-			// seperate hostname from path 
-			u32 PathStart = 0;
-			for (int i=strlen(s_SSHArg)-1; i >= 0; i--)
-			{
-				if (s_SSHArg[i] == ':')
-				{
-					PathStart = i;
-					//printf("copy %i %i %s\n", i, strlen(s_SSHArg), s_SSHArg ); 
+	return true;
+}
 
-					int Pos = 0;
-					for (int j=i+1; j <= PrefixStart; j++)
-					{
-						s_SSHPath[Pos++] = s_SSHArg[j];	
-					}
-					s_SSHPath[Pos++] = 0;
-					assert(Pos < sizeof(s_SSHPath));
+//-------------------------------------------------------------------------------------------------
+// sample lxc ring occupancy and switch the degrade policy on / off. the ring header is
+// written by the capture side so it is only read once per batch of packets
 
-					// drop the filename prefix
-					s_SSHPath[i+1] = 0;
-					break;
-				}
-			}
+#ifdef FMADIO_LXCRING
+static void RingSample(void)
+{
+	s64 Put				= s_LXCRing->Put;
+	s64 Get				= s_LXCRing->Get;
 
-			// find host
-			u32 HostStart = 0;
-			for (int i=PathStart; i >= 0; i--)
+	s_RingDepth			= s_LXCRing->Depth;
+	s_RingOccupancy		= (Put > Get) ? Put - Get : 0;
+	if (s_RingOccupancy > s_RingHigh) s_RingHigh = s_RingOccupancy;
+
+	if (s_RingDegradeMode == RING_DEGRADE_NONE) return;
+
+	float Pct = (s_RingDepth > 0) ? (s_RingOccupancy * 100.0) / s_RingDepth : 0;
+	if (!s_RingDegradeActive && (Pct >= s_RingDegradeHigh))
+	{
+		printf("lxc ring %.1f%% full, degrading output\n", Pct);
+		s_RingDegradeActive = true;
+		s_RingDegradeCnt++;
+	}
+	else if (s_RingDegradeActive && (Pct <= s_RingDegradeLow))
+	{
+		printf("lxc ring %.1f%% full, full packets resumed\n", Pct);
+		s_RingDegradeActive = false;
+	}
+}
+#endif
+
+//-------------------------------------------------------------------------------------------------
+// pcap input reads, first draining anything pushed back by a resync
+
+static int InputRead(void* Buffer, u32 Length, FILE* FIn)
+{
+	u32 Pos = 0;
+	if (s_ResyncBufferPos < s_ResyncBufferLen)
+	{
+		Pos = s_ResyncBufferLen - s_ResyncBufferPos;
+		if (Pos > Length) Pos = Length;
+
+		memcpy(Buffer, s_ResyncBuffer + s_ResyncBufferPos, Pos);
+		s_ResyncBufferPos += Pos;
+	}
+	if (Pos < Length)
+	{
+		Pos += fread((u8*)Buffer + Pos, 1, Length - Pos, FIn);
+	}
+	return Pos;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Header is a corrupt packet header just read. scan forward for the next chain of valid headers
+// and push the stream back to it. returns false if nothing was found within s_ResyncMax bytes
+
+static bool InputResync(FILE* FIn, PCAPPacket_t* Header, u32 SubSecMax)
+{
+	if ((s_ResyncMax == 0) || (s_LastPCAPTS == 0)) return false;
+
+	if (!s_ResyncBuffer)
+	{
+		s_ResyncBuffer = malloc(RESYNC_BUFFER_SIZE);
+		assert(s_ResyncBuffer != NULL);
+	}
+
+	// window starts at the bad header followed by anything not yet consumed
+	u32 Length = s_ResyncBufferLen - s_ResyncBufferPos;
+	memmove(s_ResyncBuffer + sizeof(PCAPPacket_t), s_ResyncBuffer + s_ResyncBufferPos, Length);
+	memcpy(s_ResyncBuffer, Header, sizeof(PCAPPacket_t));
+	Length += sizeof(PCAPPacket_t);
+
+	s_ResyncBufferPos	= 0;
+	s_ResyncBufferLen	= 0;
+
+	u32 LastSec			= s_LastPCAPTS / k1E9;
+	u64 Skip			= 0;
+	u32 Start			= 1;							// offset 0 is known bad
+	s64 Pos				= -1;
+	while (true)
+	{
+		Length += fread(s_ResyncBuffer + Length, 1, RESYNC_BUFFER_SIZE - Length, FIn);
+		bool IsEOF = (Length < RESYNC_BUFFER_SIZE);
+
+		Pos = Resync_Scan(s_ResyncBuffer + Start, Length - Start, LastSec, SubSecMax, IsEOF);
+		if (Pos >= 0)
+		{
+			Pos += Start;
+			break;
+		}
+		if (IsEOF || (Skip > s_ResyncMax))
+		{
+			Skip += Length;
+			break;
+		}
+
+		// slide the window, keeping the tail where a chain may have been cut short
+		u32 Drop = Length - RESYNC_KEEP;
+		memmove(s_ResyncBuffer, s_ResyncBuffer + Drop, RESYNC_KEEP);
+		Length	= RESYNC_KEEP;
+		Skip	+= Drop;
+		Start	= 0;
+	}
+
+	s_ResyncCnt++;
+	if (Pos < 0)
+	{
+		s_ResyncByte += Skip;
+		printf("Resync: no valid packets found after %.3f MB\n", Skip / 1e6);
+		return false;
+	}
+	Skip				+= Pos;
+	s_ResyncByte		+= Skip;
+
+	s_ResyncBufferPos	= Pos;
+	s_ResyncBufferLen	= Length;
+
+	// skipped bytes are not in any split
+	s_InputOffset		+= Skip;
+	s_Split.InputOffset	= -1;
+
+	printf("Resync: skipped %lli bytes at %s\n", Skip, FormatTS(s_LastPCAPTS));
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// lxc ring backpressure status
+
+static void RingStatus(void)
+{
+	printf("Ring: %lli/%lli entries High %lli Degrade %s %lli pkts (%lli times) Output Blocked %.3f sec\n",
+					s_RingOccupancy,
+					s_RingDepth,
+					s_RingHigh,
+					s_RingDegradeActive ? "on" : "off",
+					s_RingDegradePkt,
+					s_RingDegradeCnt,
+					tsc2ns(Output_BlockTSC()) / 1e9);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void SampleStatus(void)
+{
+	u64 KeepPkt = 0, SampleDrop = 0, RateDrop = 0;
+	Sample_Stats(&KeepPkt, &SampleDrop, &RateDrop);
+
+	printf("Sample: Kept %lli Sampled Out %lli Rate Limited %lli\n", KeepPkt, SampleDrop, RateDrop);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void DedupStatus(void)
+{
+	u64 DupPkt = 0, Evict = 0;
+	Dedup_Stats(&DupPkt, &Evict);
+
+	printf("Dedup: Duplicates %lli Evicted %lli\n", DupPkt, Evict);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void UploadStatus(void)
+{
+	u64 DoneCnt = 0, DoneByte = 0, FailCnt = 0, DropCnt = 0, QueueByte = 0;
+	u32 QueueDepth = 0;
+	Upload_Stats(&DoneCnt, &DoneByte, &FailCnt, &DropCnt, &QueueDepth, &QueueByte);
+
+	printf("Upload: Splits %lli %.3f GB Failed %lli Dropped %lli Spool %i %.3f GB\n", DoneCnt, DoneByte / 1e9, FailCnt, DropCnt, QueueDepth, QueueByte / 1e9);
+}
+
+//-------------------------------------------------------------------------------------------------
+// refresh the shared memory stats block
+
+static void StatsPublish(bool IsRunning)
+{
+	ShmStats_t* S = s_StatsShm;
+
+	u32 OutputUsed = 0, OutputTotal = 0, HookQueue = 0;
+	if (s_PoolOutput) Pool_Stats(s_PoolOutput, &OutputUsed, NULL, &OutputTotal);
+	if (s_Retain) Retain_Stats(NULL, NULL, NULL, &HookQueue);
+
+	ShmStats_Begin(S);
+
+	S->IsRunning			= IsRunning;
+	S->UpdateTS				= clock_ns();
+	S->TotalByte			= s_TotalByte;
+	S->TotalPkt				= s_TotalPkt;
+	S->TotalSplit			= s_TotalSplit;
+	S->DropPkt				= s_DropPkt;
+	S->ResyncByte			= s_ResyncByte;
+	S->LastPCAPTS			= s_LastPCAPTS;
+	S->OutputBufferUsed		= OutputUsed;
+	S->OutputBufferTotal	= OutputTotal;
+	S->HookQueueDepth		= HookQueue;
+	S->RingOccupancy		= s_RingOccupancy;
+	S->RingDepth			= s_RingDepth;
+	S->RingHigh				= s_RingHigh;
+	S->RingDegradeActive	= s_RingDegradeActive;
+	S->RingDegradePkt		= s_RingDegradePkt;
+	S->OutputBlockNS		= tsc2ns(Output_BlockTSC());
+	S->SplitByte			= s_Split.Byte;
+	S->SplitPkt				= s_Split.Pkt;
+	strncpy(S->FileName, s_Split.FileName, sizeof(S->FileName) - 1);
+
+	ShmStats_End(S);
+}
+
+//-------------------------------------------------------------------------------------------------
+// json stats, replaced atomically so readers never see a partial file
+
+static void StatsWrite(void)
+{
+	u8 FileNameTmp[1024];
+	sprintf(FileNameTmp, "%s.tmp", s_StatsFile);
+
+	FILE* F = fopen(FileNameTmp, "w");
+	if (!F)
+	{
+		fprintf(stderr, "stats file [%s] open failed %i %s\n", FileNameTmp, errno, strerror(errno));
+		return;
+	}
+
+	fprintf(F, "{\"time\":%lli,\"uptime_ns\":%lli,\"bytes\":%lli,\"pkts\":%lli,\"splits\":%i,\"last_pcap_ts\":%lli,\"file\":\"%s\",\"resync\":%lli,\"resync_bytes\":%lli,",
+			clock_ns(),
+			clock_ns() - s_StartTS,
+			s_TotalByte,
+			s_TotalPkt,
+			s_TotalSplit,
+			s_LastPCAPTS,
+			s_Split.FileName,
+			s_ResyncCnt,
+			s_ResyncByte);
+
+	Profile_WriteJSON(F);
+	fprintf(F, "}\n");
+	fclose(F);
+
+	rename(FileNameTmp, s_StatsFile);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void CompressStatus(void)
+{
+	u64 DoneCnt = 0, RawByte = 0;
+	u32 QueueDepth = 0;
+	Compress_Stats(&DoneCnt, &RawByte, &QueueDepth);
+
+	printf("Compress: Splits %lli %.3f GB Queued %i\n", DoneCnt, RawByte / 1e9, QueueDepth);
+}
+
+//-------------------------------------------------------------------------------------------------
+// checkpoint. small text file of key / value pairs, written to a temp file and renamed
+// over the previous one so a crash always leaves a complete checkpoint
+
+typedef struct
+{
+	s64					InputOffset;						// input consumed, -1 if not exact
+	u64					LastPCAPTS;
+	u64					LastPCAPTSCnt;						// packets at LastPCAPTS already seen
+
+	u64					TotalByte;
+	u64					TotalPkt;
+	u32					TotalSplit;
+
+	bool				SplitIsOpen;
+	u8					SplitFileName[1024];
+	u8					SplitFileNamePending[1024];
+	u8					SplitFileNameBase[1024];
+	u32					SplitSeq;
+	u64					SplitByte;
+	u64					SplitPkt;
+	u64					SplitStartPCAPTS;
+	u64					SplitTS;
+	u64					SplitLastTS;
+	s64					SplitInputOffset;
+
+	bool				PrevIsOpen;
+	u8					PrevFileName[1024];
+	u8					PrevFileNamePending[1024];
+
+} Checkpoint_t;
+
+// snapshot the current state into the temp file, CheckpointCommit makes it the checkpoint
+static bool CheckpointWrite(void)
+{
+	u8 FileNameTmp[1024];
+	sprintf(FileNameTmp, "%s.tmp", s_CheckpointFile);
+
+	FILE* F = fopen(FileNameTmp, "w");
+	if (!F)
+	{
+		fprintf(stderr, "checkpoint [%s] open failed %i %s\n", FileNameTmp, errno, strerror(errno));
+		return false;
+	}
+
+	fprintf(F, "version 1\n");
+	fprintf(F, "input_offset %lli\n",			s_InputExact ? s_InputPushOffset : -1);
+	fprintf(F, "last_pcap_ts %lli\n",			s_LastPCAPTS);
+	fprintf(F, "last_pcap_ts_cnt %lli\n",		s_LastPCAPTSCnt);
+	fprintf(F, "total_byte %lli\n",				s_TotalByte);
+	fprintf(F, "total_pkt %lli\n",				s_TotalPkt);
+	fprintf(F, "total_split %i\n",				s_TotalSplit);
+
+	fprintf(F, "split_open %i\n",				s_Split.IsOpen);
+	if (s_Split.IsOpen)
+	{
+		fprintf(F, "split_file %s\n",			s_Split.FileName);
+		fprintf(F, "split_pending %s\n",		s_Split.FileNamePending);
+		fprintf(F, "split_base %s\n",			s_Split.FileNameBase);
+		fprintf(F, "split_seq %i\n",			s_Split.Seq);
+		fprintf(F, "split_byte %lli\n",			s_Split.Byte);
+		fprintf(F, "split_pkt %lli\n",			s_Split.Pkt);
+		fprintf(F, "split_start_pcap_ts %lli\n",s_Split.StartPCAPTS);
+		fprintf(F, "split_ts %lli\n",			s_Split.TS);
+		fprintf(F, "split_last_ts %lli\n",		s_Split.LastTS);
+		fprintf(F, "split_input_offset %lli\n",	s_Split.InputOffset);
+	}
+
+	fprintf(F, "prev_open %i\n",				s_SplitPrev.IsOpen);
+	if (s_SplitPrev.IsOpen)
+	{
+		fprintf(F, "prev_file %s\n",			s_SplitPrev.FileName);
+		fprintf(F, "prev_pending %s\n",			s_SplitPrev.FileNamePending);
+	}
+
+	fflush(F);
+	fsync(fileno(F));
+	fclose(F);
+
+	return true;
+}
+
+static void CheckpointCommit(void)
+{
+	u8 FileNameTmp[1024];
+	sprintf(FileNameTmp, "%s.tmp", s_CheckpointFile);
+
+	if (rename(FileNameTmp, s_CheckpointFile) != 0)
+	{
+		fprintf(stderr, "checkpoint [%s] rename failed %i %s\n", s_CheckpointFile, errno, strerror(errno));
+	}
+}
+
+// a split still closing in the background is in neither s_Split nor s_SplitPrev, so a
+// snapshot is only committed once the splits closing when it was taken have finished.
+// nothing blocks on their fdatasync, until then the previous checkpoint still names them
+// and resume copes with them already being renamed
+static void CheckpointPoll(PCAPSplit_t* C)
+{
+	if (C->IsCheckpointTmp)
+	{
+		if (Output_IsClosing(C->CheckpointCloseSeq)) return;
+
+		CheckpointCommit();
+		C->IsCheckpointTmp = false;
+	}
+	if (!C->IsCheckpoint) return;
+	C->IsCheckpoint = false;
+
+	if (!CheckpointWrite()) return;
+	C->CheckpointCloseSeq	= Output_CloseSeq();
+	C->IsCheckpointTmp		= true;
+
+	if (!Output_IsClosing(C->CheckpointCloseSeq))
+	{
+		CheckpointCommit();
+		C->IsCheckpointTmp = false;
+	}
+}
+
+static bool CheckpointLoad(Checkpoint_t* CP)
+{
+	FILE* F = fopen(s_CheckpointFile, "r");
+	if (!F) return false;
+
+	memset(CP, 0, sizeof(Checkpoint_t));
+	CP->InputOffset			= -1;
+	CP->SplitInputOffset	= -1;
+	CP->LastPCAPTSCnt		= -1;							// older checkpoints, skip everything at LastPCAPTS
+
+	u8 Line[4096];
+	while (fgets(Line, sizeof(Line), F))
+	{
+		u8 Key[128];
+		u8 Value[2048] = { 0 };
+		if (sscanf(Line, "%127s %2047[^\n]", Key, Value) < 1) continue;
+
+		if		(strcmp(Key, "input_offset") == 0)			CP->InputOffset			= atoll(Value);
+		else if (strcmp(Key, "last_pcap_ts") == 0)			CP->LastPCAPTS			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "last_pcap_ts_cnt") == 0)		CP->LastPCAPTSCnt		= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "total_byte") == 0)			CP->TotalByte			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "total_pkt") == 0)				CP->TotalPkt			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "total_split") == 0)			CP->TotalSplit			= atoi(Value);
+		else if (strcmp(Key, "split_open") == 0)			CP->SplitIsOpen			= atoi(Value);
+		else if (strcmp(Key, "split_file") == 0)			strncpy(CP->SplitFileName, Value, sizeof(CP->SplitFileName) - 1);
+		else if (strcmp(Key, "split_pending") == 0)			strncpy(CP->SplitFileNamePending, Value, sizeof(CP->SplitFileNamePending) - 1);
+		else if (strcmp(Key, "split_base") == 0)			strncpy(CP->SplitFileNameBase, Value, sizeof(CP->SplitFileNameBase) - 1);
+		else if (strcmp(Key, "split_seq") == 0)				CP->SplitSeq			= atoi(Value);
+		else if (strcmp(Key, "split_byte") == 0)			CP->SplitByte			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "split_pkt") == 0)				CP->SplitPkt			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "split_start_pcap_ts") == 0)	CP->SplitStartPCAPTS	= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "split_ts") == 0)				CP->SplitTS				= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "split_last_ts") == 0)			CP->SplitLastTS			= strtoull(Value, NULL, 10);
+		else if (strcmp(Key, "split_input_offset") == 0)	CP->SplitInputOffset	= atoll(Value);
+		else if (strcmp(Key, "prev_open") == 0)				CP->PrevIsOpen			= atoi(Value);
+		else if (strcmp(Key, "prev_file") == 0)				strncpy(CP->PrevFileName, Value, sizeof(CP->PrevFileName) - 1);
+		else if (strcmp(Key, "prev_pending") == 0)			strncpy(CP->PrevFileNamePending, Value, sizeof(CP->PrevFileNamePending) - 1);
+	}
+	fclose(F);
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// walk the packets of a pending split. the tail may be a partially written packet
+// returns the length of the complete packets, their count, the last timestamp and how
+// many packets share it
+
+static u64 PendingScan(u8* FileName, u64* pPkt, u64* pLastTS, u64* pLastTSCnt)
+{
+	pPkt[0]		= 0;
+	pLastTS[0]	= 0;
+
+	struct stat st;
+	if (stat(FileName, &st) != 0) return 0;
+
+	FILE* F = fopen(FileName, "r");
+	if (!F) return 0;
+
+	PCAPHeader_t Header;
+	if (fread(&Header, 1, sizeof(Header), F) != sizeof(Header))
+	{
+		fclose(F);
+		return 0;
+	}
+	u64 Length = sizeof(Header);
+
+	PCAPPacket_t Pkt;
+	while (fread(&Pkt, 1, sizeof(Pkt), F) == sizeof(Pkt))
+	{
+		if ((Pkt.LengthCapture == 0) || (Pkt.LengthCapture > 128*1024)) break;
+
+		// partial payload
+		if (Length + sizeof(Pkt) + Pkt.LengthCapture > st.st_size) break;
+		if (fseeko(F, Pkt.LengthCapture, SEEK_CUR) != 0) break;
+
+		u64 TS = (u64)Pkt.Sec * k1E9 + Pkt.NSec;
+		if (TS != pLastTS[0]) pLastTSCnt[0] = 0;
+
+		Length			+= sizeof(Pkt) + Pkt.LengthCapture;
+		pPkt[0]			+= 1;
+		pLastTS[0]		 = TS;
+		pLastTSCnt[0]	+= 1;
+	}
+	fclose(F);
+
+	return Length;
+}
+//-------------------------------------------------------------------------------------------------
+// restart from the checkpoint. the previous split held open for late packets is closed out,
+// the pending split is either continued or closed out, then input already written is skipped
+
+static bool Resume(FILE* FIn)
+{
+	Checkpoint_t CP;
+	if (!CheckpointLoad(&CP))
+	{
+		printf("Resume: no checkpoint [%s] starting from the beginning\n", s_CheckpointFile);
+		return true;
+	}
+
+	s_TotalByte		= CP.TotalByte;
+	s_TotalPkt		= CP.TotalPkt;
+	s_TotalSplit	= CP.TotalSplit;
+
+	// nothing more will arrive for it
+	if (CP.PrevIsOpen)
+	{
+		printf("Resume: finalize [%s]\n", CP.PrevFileName);
+		RenameFile(s_OutputMode, CP.PrevFileNamePending, CP.PrevFileName);
+		if (s_FileNameUID) chown(CP.PrevFileName, s_FileNameUID, s_FileNameGID);
+		if (s_Retain) Retain_Add(CP.PrevFileName);
+	}
+
+	s64 SkipOffset	= CP.InputOffset;
+	u64 SkipTS		= CP.LastPCAPTS;
+	u64 SkipCnt		= CP.LastPCAPTSCnt;
+
+	if (CP.SplitIsOpen)
+	{
+		// boundary and naming carry over
+		strcpy(s_Split.FileName,		CP.SplitFileName);
+		strcpy(s_Split.FileNamePending,	CP.SplitFileNamePending);
+		strcpy(s_Split.FileNameBase,	CP.SplitFileNameBase);
+		s_Split.Seq			= CP.SplitSeq;
+		s_Split.TS			= CP.SplitTS;
+		s_Split.LastTS		= CP.SplitLastTS;
+		s_Split.NextTS		= (s_SplitMode & SPLIT_MODE_TIME) ? SplitTimeNext(CP.SplitTS) : 0;
+		s_Split.StartTS		= clock_ns();
+		s_Split.StartPCAPTS	= CP.SplitStartPCAPTS;
+
+		// a plain local file shows exactly how far the split got. it may already have been
+		// renamed if the checkpoint was taken just before the split closed
+		u64 Length		= 0;
+		u64 Pkt			= 0;
+		u64 LastTS		= 0;
+		u64 LastTSCnt	= 0;
+		bool IsClosed	= false;
+
+		struct stat st;
+		if ((s_OutputMode == OUTPUT_MODE_CAT) && (strcmp(s_PipeCmd, "cat") == 0))
+		{
+			if (stat(CP.SplitFileNamePending, &st) == 0)
 			{
-				if ((s_SSHArg[i] == ' ') || (i ==0) )
+				Length = PendingScan(CP.SplitFileNamePending, &Pkt, &LastTS, &LastTSCnt);
+
+				// not even the header made it to disk, restart the split from its first packet
+				if (Length < sizeof(PCAPHeader_t))
 				{
-					HostStart = i;
-					u32 Pos = 0;
-					for (int j=i; j < PathStart; j++)
+					int fd = open(CP.SplitFileNamePending, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+					if ((fd < 0) || (write(fd, &s_HeaderMaster, sizeof(s_HeaderMaster)) != sizeof(s_HeaderMaster)))
 					{
-						s_SSHHost[Pos++] = s_SSHArg[j];
+						printf("Resume: failed to rewrite [%s] %i %s\n", CP.SplitFileNamePending, errno, strerror(errno));
+						return false;
 					}
-					s_SSHHost[Pos++] = 0; 
-					assert(Pos < sizeof(s_SSHHost));
+					close(fd);
 
-					break;
+					Length = sizeof(PCAPHeader_t);
 				}
 			}
-
-			u32 Pos = 0;
-			for (int i=0; i < HostStart; i++)
+			else if (stat(CP.SplitFileName, &st) == 0)
 			{
-				s_SSHOpt[Pos++] = s_SSHArg[i];
+				Length = PendingScan(CP.SplitFileName, &Pkt, &LastTS, &LastTSCnt);
+				IsClosed = true;
 			}
-			s_SSHOpt[Pos++] = 0; 
-			assert(Pos < sizeof(s_SSHOpt));
-
-			OutputMode = OUTPUT_MODE_SSH;
-			fprintf(stderr, "    Output Mode SSH Opt    (%s)\n", s_SSHOpt);
-			fprintf(stderr, "                    Host   (%s)\n", s_SSHHost);
-			fprintf(stderr, "                    Path   (%s)\n", s_SSHPath);
-			fprintf(stderr, "                    Prefix (%s)\n", s_SSHPrefix);
-			i += 1;
-		}
-		else if (strcmp(argv[i], "--null") == 0)
-		{
-			OutputMode = OUTPUT_MODE_NULL;
-			fprintf(stderr, "    Output Mode NULL\n");
 		}
-		else if (strcmp(argv[i], "--script-new") == 0)
-		{
-			s_ScriptNew = true;
-			strncpy(s_ScriptNewCmd, argv[i+1], sizeof(s_ScriptNewCmd));	
 
-			fprintf(stderr, "    Script New Hook [%s]\n", s_ScriptNewCmd);
-			i++;
-		}
-		else if (strcmp(argv[i], "--script-close") == 0)
+		if (Length >= sizeof(PCAPHeader_t))
 		{
-			s_ScriptClose = true;
-			strncpy(s_ScriptCloseCmd, argv[i+1], sizeof(s_ScriptCloseCmd));	
+			// input continues right after the last packet in the file
+			SkipOffset	= (CP.SplitInputOffset >= 0) ? CP.SplitInputOffset + Length - sizeof(PCAPHeader_t) : -1;
+			SkipTS		= (Pkt > 0) ? LastTS : CP.SplitStartPCAPTS - 1;
+			SkipCnt		= (Pkt > 0) ? LastTSCnt : -1;
 
-			fprintf(stderr, "    Script Close Hook [%s]\n", s_ScriptCloseCmd);
-			i++;
+			// drop any partially written packet
+			if (!IsClosed && (truncate(CP.SplitFileNamePending, Length) != 0))
+			{
+				printf("Resume: failed to trim [%s] %i %s\n", CP.SplitFileNamePending, errno, strerror(errno));
+				return false;
+			}
 		}
 
-		else if (strcmp(argv[i], "-Z") == 0)
+		if (IsClosed)
 		{
-			u8* UserName       = argv[i+1]; 
+			printf("Resume: [%s] already closed\n", CP.SplitFileName);
+		}
+		else if ((s_ResumeMode == RESUME_CONTINUE) && (Length >= sizeof(PCAPHeader_t)))
+		{
+			u8 Cmd[4096];
+			sprintf(Cmd, "%s >> '%s'", s_PipeCmd, CP.SplitFileNamePending);
+			printf("[%s]\n", Cmd);
 
-			struct passwd *pwd 	= getpwnam(UserName);
-			if (pwd != NULL)
+			s_Split.Out = Output_Open(Cmd, CP.SplitFileNamePending, OUTPUT_OPEN_APPEND);
+			if (!s_Split.Out)
 			{
-		    	s_FileNameUID		= pwd->pw_uid;
-				s_FileNameGID		= pwd->pw_gid;
+				printf("OutputFilename is invalid [%s] %i %s\n", CP.SplitFileNamePending, errno, strerror(errno));
+				return false;
 			}
-			else
-			{
-				// search for UID:GID style
-				u8 sUID[128];
-				u8 sGID[128];
+			s_Split.IsOpen		= true;
+			s_Split.Byte		= Length - sizeof(PCAPHeader_t);
+			s_Split.Pkt			= Pkt;
+			s_Split.InputOffset	= CP.SplitInputOffset;
 
-				u32 UIDPos = 0;
-				u32 GIDPos = 0;
+			printf("Resume: continue [%s] Bytes %lli Pkts %lli\n", s_Split.FileName, s_Split.Byte, s_Split.Pkt);
+		}
+		else
+		{
+			// next packet opens a new split
+			printf("Resume: finalize [%s]\n", CP.SplitFileName);
+			RenameFile(s_OutputMode, CP.SplitFileNamePending, CP.SplitFileName);
+			if (s_FileNameUID) chown(CP.SplitFileName, s_FileNameUID, s_FileNameGID);
+			if (s_Retain) Retain_Add(CP.SplitFileName);
+		}
+	}
 
-				int i=0;
-				for (; i < strlen(UserName); i++)
-				{
-					u32 c = UserName[i];
-					if ((c == ':') || (c == '.'))
-					{
-						sUID[UIDPos] = 0;
-						break;
-					}
+	// seekable input jumps straight there, otherwise drop packets by timestamp
+	if ((SkipOffset >= 0) && s_InputExact && (fseeko(FIn, SkipOffset, SEEK_SET) == 0))
+	{
+		printf("Resume: input seek to %lli\n", SkipOffset);
+		s_InputOffset		= SkipOffset;
+		s_InputPushOffset	= SkipOffset;
+	}
+	else
+	{
+		printf("Resume: skipping input up to %s +%lli packets\n", FormatTS(SkipTS), (SkipCnt == (u64)-1) ? 0 : SkipCnt);
+		s_ResumeSkipTS	= SkipTS;
+		s_ResumeSkipCnt	= SkipCnt;
+	}
+	s_LastPCAPTS	= CP.LastPCAPTS;
+	s_LastPCAPTSCnt	= CP.LastPCAPTSCnt;
 
-					sUID[UIDPos++] = c;
-				}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// parse the options, validate and open the output side. shared by the cli and libpcapsplit
+
+static bool SplitSetup(int argc, char* argv[])
+{
+	u32 CPUList[128];
+	u32 CPUListCnt		= 0;
+
+	// default do nothing output
+	strcpy(s_PipeCmd, "cat");
+
+
+	// default .pcap raw
+	strcpy(s_FileNameSuffix, ".pcap");
+
+	fprintf(stderr, "args\n");
+	for (int i=1; i < argc; i++)
+	{
+		fprintf(stderr, "  %s\n", argv[i]);
+	}
+
+	for (int i=1; i < argc; i++)
+	{
+		fprintf(stderr, "%s\n", argv[i]);
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			Help();
+			return false;
+		}
+		// dummy uid for analytics scripts
+		else if (strcmp(argv[i], "--uid") == 0)
+		{
+			u8* UID = argv[i+1];
+			i++;
+			fprintf(stderr, "    UID [%s]\n", UID);
+		}
+		else if (strcmp(argv[i], "-o") == 0)
+		{
+			s_OutFileName = argv[i+1];
+			fprintf(stderr, "    OutputName [%s]\n", s_OutFileName);
+			i++;
+		}
+
+		// parse a list of avaliable CPUs
+		else if (strcmp(argv[i], "--cpu") == 0)
+		{
+			u8* CPUStr   = argv[i+1];
+			u32 CPUStrLen = strlen(CPUStr);
+			u8* CPUStart = CPUStr; 
+			for (int i=0; i <= CPUStrLen; i++)
+			{
+				if ((CPUStr[i] == ',') || (CPUStr[i] == 0))
+				{
+					CPUStr[i] = 0;
+
+					u32 CPU = atoi(CPUStart);
+					CPUList[CPUListCnt++] = CPU;
+
+					fprintf(stderr, "CPU [%i]\n", CPU);
+					CPUStart = &CPUStr[i+1];
+				}
+			}
+
+			i++;
+			fprintf(stderr, "    CPUList Cnt:%i [", CPUListCnt);
+			for (int i=0; i < CPUListCnt; i++)
+			{
+				fprintf(stderr, "%i ", CPUList[i]);
+			}
+			fprintf(stderr, "]\n", CPUList[i]);
+		}
+		else if (strcmp(argv[i], "--ring") == 0)
+		{
+			#ifndef FMADIO_LXCRING
+				fprintf(stderr, "ERROR: LXC Ring support not comipled in\n");
+				assert (false);
+			#endif
+
+			s_LXCRingPath = argv[i+1];
+			fprintf(stderr, "    Input from lxc_ring:%s\n", s_LXCRingPath);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ring-degrade") == 0)
+		{
+			if (sscanf(argv[i+1], "slice:%u", &s_RingDegradeArg) == 1)
+			{
+				s_RingDegradeMode = RING_DEGRADE_SLICE;
+				if (s_RingDegradeArg < 64) s_RingDegradeArg = 64;
+			}
+			else if (sscanf(argv[i+1], "sample:%u", &s_RingDegradeArg) == 1)
+			{
+				s_RingDegradeMode = RING_DEGRADE_SAMPLE;
+				if (s_RingDegradeArg < 1) s_RingDegradeArg = 1;
+			}
+			else
+			{
+				fprintf(stderr, "unknown ring degrade policy [%s] expected slice:<bytes> or sample:<n>\n", argv[i+1]);
+				return false;
+			}
+			fprintf(stderr, "    lxc ring degrade %s %i\n", (s_RingDegradeMode == RING_DEGRADE_SLICE) ? "slice" : "sample", s_RingDegradeArg);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ring-high") == 0)
+		{
+			s_RingDegradeHigh = atof(argv[i+1]);
+			fprintf(stderr, "    lxc ring degrade above %.1f%%\n", s_RingDegradeHigh);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ring-low") == 0)
+		{
+			s_RingDegradeLow = atof(argv[i+1]);
+			fprintf(stderr, "    lxc ring recover below %.1f%%\n", s_RingDegradeLow);
+			i++;
+		}
+		else if (strcmp(argv[i], "--split-byte") == 0)
+		{
+			s_SplitMode |= SPLIT_MODE_BYTE; 
+
+			s_TargetByte = atof(argv[i+1]);
+			i++;
+
+			fprintf(stderr, "    Split Every %lli Bytes %.3f GByte\n", s_TargetByte, s_TargetByte / (double)kGB(1));
+		}
+		else if (strcmp(argv[i], "--split-time") == 0)
+		{
+			s_SplitMode |= SPLIT_MODE_TIME; 
+
+			s_TargetTime = atof(argv[i+1]);
+			i++;
+
+			fprintf(stderr, "    Split Every %f Sec\n", s_TargetTime / 1e9);
+		}
+		else if (strcmp(argv[i], "--split-calendar") == 0)
+		{
+			s_SplitMode |= SPLIT_MODE_TIME; 
+
+			if		(strcmp(argv[i+1], "hour")	== 0) s_SplitCalendar = SPLIT_CALENDAR_HOUR;
+			else if (strcmp(argv[i+1], "day")	== 0) s_SplitCalendar = SPLIT_CALENDAR_DAY;
+			else if (strcmp(argv[i+1], "week")	== 0) s_SplitCalendar = SPLIT_CALENDAR_WEEK;
+			else if (strcmp(argv[i+1], "month")	== 0) s_SplitCalendar = SPLIT_CALENDAR_MONTH;
+			else
+			{
+				fprintf(stderr, "unknown calendar split [%s]\n", argv[i+1]);
+				return false;
+			}
+			fprintf(stderr, "    Split Every Calendar %s\n", argv[i+1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "--split-packets") == 0)
+		{
+			s_SplitMode |= SPLIT_MODE_PACKET; 
+
+			s_TargetPkt = atof(argv[i+1]);
+			i++;
+
+			fprintf(stderr, "    Split Every %lli Packets\n", s_TargetPkt);
+		}
+		else if (strcmp(argv[i], "--split-time-roundup") == 0)
+		{
+			s_TargetTimeRoundup  = atof(argv[i+1]);
+			i++;
+
+			fprintf(stderr, "    Split Foundup %.6fsec\n", s_TargetTimeRoundup / 1e9);
+		}
+		else if (strcmp(argv[i], "--split-time-fill") == 0)
+		{
+			s_SplitFill = true;
+			fprintf(stderr, "    Split Time fill missing periods\n");
+		}
+		else if (strcmp(argv[i], "--split-time-fill-max") == 0)
+		{
+			s_SplitFill = true;
+			s_SplitFillMax = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Split Time fill max %lli splits per gap\n", s_SplitFillMax);
+		}
+		else if (strcmp(argv[i], "--reorder-window") == 0)
+		{
+			s_ReorderWindow = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Reorder window %.3f msec\n", s_ReorderWindow / 1e6);
+		}
+		else if (strcmp(argv[i], "--reorder-window-pkt") == 0)
+		{
+			s_ReorderWindowPkt = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Reorder window %lli packets\n", s_ReorderWindowPkt);
+		}
+		else if (strcmp(argv[i], "--idle-flush") == 0)
+		{
+			s_IdleFlush = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Idle flush after %.3f sec\n", s_IdleFlush / 1e9);
+		}
+		else if (strcmp(argv[i], "--wallclock-roll") == 0)
+		{
+			s_WallClockRoll = true;
+			fprintf(stderr, "    Time splits roll on the wall clock while idle\n");
+		}
+		else if (strcmp(argv[i], "--reorder-buffer") == 0)
+		{
+			s_ReorderBufferMax = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Reorder buffer %i packets\n", s_ReorderBufferMax);
+		}
+		else if (strcmp(argv[i], "--resync-max") == 0)
+		{
+			s_ResyncMax = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Resync max scan %.3f MB\n", s_ResyncMax / 1e6);
+		}
+		else if (strcmp(argv[i], "--dedup") == 0)
+		{
+			s_Dedup 				= true;
+			s_DedupConfig.Window	= atof(argv[i+1]);
+			fprintf(stderr, "    Dedup window %.3f msec\n", s_DedupConfig.Window / 1e6);
+			i++;
+		}
+		else if (strcmp(argv[i], "--dedup-table") == 0)
+		{
+			s_DedupConfig.TableSize	= atof(argv[i+1]);
+			fprintf(stderr, "    Dedup table %i entries\n", s_DedupConfig.TableSize);
+			i++;
+		}
+		else if (strcmp(argv[i], "--dedup-ignore-ttl") == 0)
+		{
+			s_DedupConfig.IsIgnoreTTL = true;
+			fprintf(stderr, "    Dedup ignoring ttl and ip checksum\n");
+		}
+		else if (strcmp(argv[i], "--sample") == 0)
+		{
+			s_Sample 				= true;
+			s_SampleConfig.Mode		= SAMPLE_MODE_COUNT;
+			s_SampleConfig.Rate		= atof(argv[i+1]);
+			fprintf(stderr, "    Sample 1 in %i packets\n", s_SampleConfig.Rate);
+			i++;
+		}
+		else if (strcmp(argv[i], "--sample-flow") == 0)
+		{
+			s_Sample 				= true;
+			s_SampleConfig.Mode		= SAMPLE_MODE_FLOW;
+			s_SampleConfig.Rate		= atof(argv[i+1]);
+			fprintf(stderr, "    Sample 1 in %i flows\n", s_SampleConfig.Rate);
+			i++;
+		}
+		else if (strcmp(argv[i], "--rate-limit") == 0)
+		{
+			s_Sample 				= true;
+			s_SampleConfig.RateLimit= atof(argv[i+1]);
+			fprintf(stderr, "    Output rate limit %.3f Gbps\n", s_SampleConfig.RateLimit / 1e9);
+			i++;
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			s_Profile = true;
+			fprintf(stderr, "    Profile stages\n");
+		}
+		else if (strcmp(argv[i], "--stats-file") == 0)
+		{
+			s_StatsFile = argv[i+1];
+			i++;
+			fprintf(stderr, "    Stats file [%s]\n", s_StatsFile);
+		}
+		else if (strcmp(argv[i], "--stats-shm") == 0)
+		{
+			s_StatsShmPath = argv[i+1];
+			i++;
+			fprintf(stderr, "    Stats shm [%s]\n", s_StatsShmPath);
+		}
+		else if (strcmp(argv[i], "--stats-dump") == 0)
+		{
+			// one shot reader of another instance, nothing here is set up
+			exit(ShmStats_Dump(argv[i+1]));
+		}
+		else if (strcmp(argv[i], "--checkpoint") == 0)
+		{
+			s_CheckpointFile = argv[i+1];
+			i++;
+			fprintf(stderr, "    Checkpoint [%s]\n", s_CheckpointFile);
+		}
+		else if (strcmp(argv[i], "--resume") == 0)
+		{
+			s_ResumeMode = RESUME_CONTINUE;
+			fprintf(stderr, "    Resume pending split\n");
+		}
+		else if (strcmp(argv[i], "--resume-finalize") == 0)
+		{
+			s_ResumeMode = RESUME_FINALIZE;
+			fprintf(stderr, "    Resume finalizing pending split\n");
+		}
+		else if (strcmp(argv[i], "--retain-count") == 0)
+		{
+			s_RetainConfig.MaxCount = atof(argv[i+1]);
+			s_Retain = true;
+			i++;
+			fprintf(stderr, "    Retain %i splits\n", s_RetainConfig.MaxCount);
+		}
+		else if (strcmp(argv[i], "--retain-byte") == 0)
+		{
+			s_RetainConfig.MaxByte = atof(argv[i+1]);
+			s_Retain = true;
+			i++;
+			fprintf(stderr, "    Retain %.3f GB of splits\n", s_RetainConfig.MaxByte / 1e9);
+		}
+		else if (strcmp(argv[i], "--retain-pct") == 0)
+		{
+			s_RetainConfig.MaxPct = atof(argv[i+1]);
+			s_Retain = true;
+			i++;
+			fprintf(stderr, "    Retain filesystem below %.1f%%\n", s_RetainConfig.MaxPct);
+		}
+		else if (strcmp(argv[i], "--retain-hook") == 0)
+		{
+			s_RetainConfig.HookCmd = argv[i+1];
+			i++;
+			fprintf(stderr, "    Retain hook [%s]\n", s_RetainConfig.HookCmd);
+		}
+		else if (strcmp(argv[i], "--retain-recycle") == 0)
+		{
+			s_RetainConfig.IsRecycle = true;
+			fprintf(stderr, "    Retain recycle oldest split\n");
+		}
+		else if (strcmp(argv[i], "--packet-chomp") == 0)
+		{
+			s_PacketChomp = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    chomp every packet by %i bytes\n", s_PacketChomp);
+		}
+		else if (strcmp(argv[i], "--roll-period") == 0)
+		{
+			s_RollPeriodSetup = false;
+			s_RollPeriod = atof(argv[i+1]);
+			i++;
+			fprintf(stderr, "    Roll Period %.3f hours\n", s_RollPeriod/(60*60*1e9) );
+		}
+		else if (strcmp(argv[i], "--filename-epoch-sec") == 0)
+		{
+			fprintf(stderr, "    Filename EPOCH Sec\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_EPOCH_SEC;
+		}
+		else if (strcmp(argv[i], "--filename-epoch-sec-startend") == 0)
+		{
+			fprintf(stderr, "    Filename EPOCH Sec Start/End\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_EPOCH_SEC_STARTEND;
+		}
+		else if (strcmp(argv[i], "--filename-epoch-msec") == 0)
+		{
+			fprintf(stderr, "    Filename EPOCH MSec\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_EPOCH_MSEC;
+		}
+		else if (strcmp(argv[i], "--filename-epoch-usec") == 0)
+		{
+			fprintf(stderr, "    Filename EPOCH Micro Sec\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_EPOCH_USEC;
+		}
+		else if (strcmp(argv[i], "--filename-epoch-nsec") == 0)
+		{
+			fprintf(stderr, "    Filename EPOCH nano Sec\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_EPOCH_NSEC;
+		}
+		else if (strcmp(argv[i], "--filename-tstr-HHMM") == 0)
+		{
+			fprintf(stderr, "    Filename TimeString HHMM\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_TSTR_HHMM;
+		}
+		else if (strcmp(argv[i], "--filename-tstr-HHMMSS") == 0)
+		{
+			fprintf(stderr, "    Filename TimeString HHMMSS\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_TSTR_HHMMSS;
+		}
+		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_TZ") == 0)
+		{
+			fprintf(stderr, "    Filename TimeString HHMMSS_TZ\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_TSTR_HHMMSS_TZ;
+		}
+
+		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_NS") == 0)
+		{
+			fprintf(stderr, "    Filename TimeString HHMMSS Nano\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_TSTR_HHMMSS_NS;
+		}
+		else if (strcmp(argv[i], "--filename-tstr-HHMMSS_SUB") == 0)
+		{
+			fprintf(stderr, "    Filename TimeString HHMMSS Subseconds\n");
+			s_FileNameTemplate	= FILENAME_TEMPLATE_TSTR_HHMMSS_SUB;
+		}
+		else if (strcmp(argv[i], "--filename-strftime") == 0)
+		{
+			s_FileNameTemplate	= s_strftimeFormat;
+			strncpy(s_strftimeFormat, argv[i+1], sizeof(s_strftimeFormat));
+
+			fprintf(stderr, "    Filename TimeString (%s)\n", s_strftimeFormat);
+			i++;
+		}
+		else if (strcmp(argv[i], "--filename-template") == 0)
+		{
+			s_FileNameTemplate	= argv[i+1];
+			fprintf(stderr, "    Filename Template (%s)\n", s_FileNameTemplate);
+			i++;
+		}
+		else if (strcmp(argv[i], "--pipe-cmd") == 0)
+		{
+			strncpy(s_PipeCmd, argv[i+1], sizeof(s_PipeCmd));	
+			fprintf(stderr, "    pipe cmd [%s]\n", s_PipeCmd);
+			i++;
+		}
+		else if (strcmp(argv[i], "--filename-suffix") == 0)
+		{
+			strncpy(s_FileNameSuffix, argv[i+1], sizeof(s_FileNameSuffix));	
+			fprintf(stderr, "    Filename Suffix [%s]\n", s_FileNameSuffix);
+			i++;
+		}
+		else if (strcmp(argv[i], "--rclone") == 0)
+		{
+			s_OutputMode = OUTPUT_MODE_RCLONE;
+			fprintf(stderr, "    Output Mode RClone\n");
+		}
+		else if (strcmp(argv[i], "--curl") == 0)
+		{
+			strncpy(s_CURLArg , 	argv[i+1], sizeof(s_CURLArg)	);	
+			strncpy(s_CURLPath, 	argv[i+2], sizeof(s_CURLPath)	);	
+
+			// seperate the path from the filename prefix 
+			for (int i=strlen(s_CURLPath)-1; i >= 0; i--)
+			{
+				if (s_CURLPath[i] == '/')
+				{
+					printf("copy %i %i %s\n", i, strlen(s_CURLPath), s_CURLPath ); 
+
+					int Pos = 0;
+					for (int j=i+1; j < strlen(s_CURLPath); j++)
+					{
+						s_CURLPrefix[Pos++] = s_CURLPath[j];	
+					}
+					s_CURLPrefix[Pos++] = 0;
+
+					// drop the filename prefix
+					s_CURLPath[i+1] = 0;
+					break;
+				}
+			}
+
+			s_OutputMode = OUTPUT_MODE_CURL;
+			fprintf(stderr, "    Output Mode CURL (%s) (%s) (%s)\n", s_CURLArg, s_CURLPath, s_CURLPrefix);
+			i += 2;
+		}
+		else if ((strcmp(argv[i], "--spool") == 0) || (strcmp(argv[i], "--curl-stage") == 0))
+		{
+			s_SpoolDir = argv[i+1];
+			fprintf(stderr, "    Spool splits in (%s) and upload in the background\n", s_SpoolDir);
+			i++;
+		}
+		else if (strcmp(argv[i], "--spool-max") == 0)
+		{
+			s_UploadConfig.SpoolMax = atof(argv[i+1]);
+			fprintf(stderr, "    Spool max %.3f GB\n", s_UploadConfig.SpoolMax / 1e9);
+			i++;
+		}
+		else if (strcmp(argv[i], "--upload-workers") == 0)
+		{
+			s_UploadConfig.WorkerCnt = atoi(argv[i+1]);
+			fprintf(stderr, "    Upload workers %i\n", s_UploadConfig.WorkerCnt);
+			i++;
+		}
+		else if (strcmp(argv[i], "--upload-retry") == 0)
+		{
+			s_UploadConfig.RetryMax = atoi(argv[i+1]);
+			fprintf(stderr, "    Upload attempts %i\n", s_UploadConfig.RetryMax);
+			i++;
+		}
+		else if (strcmp(argv[i], "--compress-workers") == 0)
+		{
+			s_CompressWorker = atoi(argv[i+1]);
+			fprintf(stderr, "    Compress workers %i\n", s_CompressWorker);
+			i++;
+		}
+		else if (strcmp(argv[i], "--compress-stage") == 0)
+		{
+			s_CompressStage = argv[i+1];
+			fprintf(stderr, "    Compress stage (%s)\n", s_CompressStage);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ssh-no-mux") == 0)
+		{
+			s_SSHMux = false;
+			fprintf(stderr, "    SSH connection per split\n");
+		}
+		else if (strcmp(argv[i], "--ssh") == 0)
+		{
+			strncpy(s_SSHArg , 	argv[i+1], sizeof(s_SSHArg)	);	
+
+			// seperate the path from the filename prefix 
+			u32 PrefixStart = 0;
+			for (int i=strlen(s_SSHArg)-1; i >= 0; i--)
+			{
+				if (s_SSHArg[i] == '/')
+				{
+					PrefixStart = i;
+					//printf("copy %i %i %s\n", i, strlen(s_SSHArg), s_SSHArg ); 
+
+					int Pos = 0;
+					for (int j=i+1; j < strlen(s_SSHArg); j++)
+					{
+						s_SSHPrefix[Pos++] = s_SSHArg[j];	
+					}
+					s_SSHPrefix[Pos++] = 0;
+					assert(Pos < sizeof(s_SSHPrefix));
+
+					// drop the filename prefix
+					s_SSHPath[i+1] = 0;
+					break;
+				}
+			}
+
+			// seperate hostname from path 
+			u32 PathStart = 0;
+			for (int i=strlen(s_SSHArg)-1; i >= 0; i--)
+			{
+				if (s_SSHArg[i] == ':')
+				{
+					PathStart = i;
+					//printf("copy %i %i %s\n", i, strlen(s_SSHArg), s_SSHArg ); 
+
+					int Pos = 0;
+					for (int j=i+1; j <= PrefixStart; j++)
+					{
+						s_SSHPath[Pos++] = s_SSHArg[j];	
+					}
+					s_SSHPath[Pos++] = 0;
+					assert(Pos < sizeof(s_SSHPath));
+
+					// drop the filename prefix
+					s_SSHPath[i+1] = 0;
+					break;
+				}
+			}
+
+			// find host
+			u32 HostStart = 0;
+			for (int i=PathStart; i >= 0; i--)
+			{
+				if ((s_SSHArg[i] == ' ') || (i ==0) )
+				{
+					HostStart = i;
+					u32 Pos = 0;
+					for (int j=i; j < PathStart; j++)
+					{
+						s_SSHHost[Pos++] = s_SSHArg[j];
+					}
+					s_SSHHost[Pos++] = 0; 
+					assert(Pos < sizeof(s_SSHHost));
+
+					break;
+				}
+			}
+
+			u32 Pos = 0;
+			for (int i=0; i < HostStart; i++)
+			{
+				s_SSHOpt[Pos++] = s_SSHArg[i];
+			}
+			s_SSHOpt[Pos++] = 0; 
+			assert(Pos < sizeof(s_SSHOpt));
+
+			s_OutputMode = OUTPUT_MODE_SSH;
+			fprintf(stderr, "    Output Mode SSH Opt    (%s)\n", s_SSHOpt);
+			fprintf(stderr, "                    Host   (%s)\n", s_SSHHost);
+			fprintf(stderr, "                    Path   (%s)\n", s_SSHPath);
+			fprintf(stderr, "                    Prefix (%s)\n", s_SSHPrefix);
+			i += 1;
+		}
+		else if (strcmp(argv[i], "--null") == 0)
+		{
+			s_OutputMode = OUTPUT_MODE_NULL;
+			fprintf(stderr, "    Output Mode NULL\n");
+		}
+		else if (strcmp(argv[i], "--io-uring") == 0)
+		{
+			s_OutputEngine = OUTPUT_ENGINE_URING;
+			fprintf(stderr, "    Output Engine io_uring\n");
+		}
+		else if (strcmp(argv[i], "--io-uring-depth") == 0)
+		{
+			s_UringDepth = atoi(argv[i+1]);
+			fprintf(stderr, "    io_uring Depth %i\n", s_UringDepth);
+			i++;
+		}
+		else if (strcmp(argv[i], "--io-uring-bufsize") == 0)
+		{
+			s_UringBufferSize = atof(argv[i+1]);
+			fprintf(stderr, "    io_uring Buffer Size %i KB\n", s_UringBufferSize / 1024);
+			i++;
+		}
+		else if (strcmp(argv[i], "--o-direct") == 0)
+		{
+			s_OutputEngine	= OUTPUT_ENGINE_URING;
+			s_OutputFlags	|= OUTPUT_FLAG_DIRECT;
+			fprintf(stderr, "    Output O_DIRECT\n");
+		}
+		else if (strcmp(argv[i], "--drop-cache") == 0)
+		{
+			s_OutputEngine	= OUTPUT_ENGINE_URING;
+			s_OutputFlags	|= OUTPUT_FLAG_DROPCACHE;
+			fprintf(stderr, "    Output Drop Page Cache\n");
+		}
+		else if (strcmp(argv[i], "--script-new") == 0)
+		{
+			s_ScriptNew = true;
+			strncpy(s_ScriptNewCmd, argv[i+1], sizeof(s_ScriptNewCmd));	
+
+			fprintf(stderr, "    Script New Hook [%s]\n", s_ScriptNewCmd);
+			i++;
+		}
+		else if (strcmp(argv[i], "--script-close") == 0)
+		{
+			s_ScriptClose = true;
+			strncpy(s_ScriptCloseCmd, argv[i+1], sizeof(s_ScriptCloseCmd));	
+
+			fprintf(stderr, "    Script Close Hook [%s]\n", s_ScriptCloseCmd);
+			i++;
+		}
+		else if (strcmp(argv[i], "--plugin") == 0)
+		{
+			s_PluginPath = argv[i+1];
+			fprintf(stderr, "    Plugin [%s]\n", s_PluginPath);
+			i++;
+		}
+		else if (strcmp(argv[i], "--plugin-arg") == 0)
+		{
+			s_PluginArg = argv[i+1];
+			fprintf(stderr, "    Plugin Arg [%s]\n", s_PluginArg);
+			i++;
+		}
+
+		else if (strcmp(argv[i], "-Z") == 0)
+		{
+			u8* UserName       = argv[i+1]; 
+
+			struct passwd *pwd 	= getpwnam(UserName);
+			if (pwd != NULL)
+			{
+		    	s_FileNameUID		= pwd->pw_uid;
+				s_FileNameGID		= pwd->pw_gid;
+			}
+			else
+			{
+				// search for UID:GID style
+				u8 sUID[128];
+				u8 sGID[128];
+
+				u32 UIDPos = 0;
+				u32 GIDPos = 0;
+
+				int i=0;
+				for (; i < strlen(UserName); i++)
+				{
+					u32 c = UserName[i];
+					if ((c == ':') || (c == '.'))
+					{
+						sUID[UIDPos] = 0;
+						break;
+					}
+
+					sUID[UIDPos++] = c;
+				}
+
+				// skip :
+				i++;
+
+				for (; i < strlen(UserName); i++)
+				{
+					u32 c = UserName[i];
+					sGID[GIDPos++] = c;
+				}
+				sGID[GIDPos] = 0;
+
+				fprintf(stderr, "UID[%s] GID[%s]\n", sUID, sGID);
+
+		    	s_FileNameUID		= atoi(sUID); 
+				s_FileNameGID		= atoi(sGID); 
 
-				// skip :
-				i++;
+				// if its not a UID/GID number try it as a username/group string
+				if (s_FileNameUID == 0)
+				{
+					struct passwd *pwd 	= getpwnam(sUID);
+					if (pwd != NULL)
+					{
+		    			s_FileNameUID		= pwd->pw_uid;
+					}
+				}
+				if (s_FileNameGID == 0)
+				{
+					struct group *grp = getgrnam(sGID);
+					if (grp != NULL)
+					{
+		    			s_FileNameGID		= grp->gr_gid;
+					}
+				}
+			}
+
+			fprintf(stderr, "UserName (%s) %i:%i\n", UserName, s_FileNameUID, s_FileNameGID); 
+			i++;
+		}
+		else
+		{
+			fprintf(stderr, "unknown command [%s]\n", argv[i]);
+			return false;
+		}
+	}
+
+	// set cpu affinity
+	s32 NUMANode = -1;
+	if (CPUListCnt > 0)
+	{
+		NUMANode = Pool_CPUNode(CPUList[0]);
+
+		cpu_set_t	MainCPUS;
+		CPU_ZERO(&MainCPUS);
+
+		for (int i=0; i < CPUListCnt; i++)
+		{
+			CPU_SET(CPUList[i], &MainCPUS);
+		}
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &MainCPUS);
+	}
+
+
+	
+	// local timezone transitions, pcap timestamps are always epoch
+	// so the offset is looked up per timestamp as it changes with DST
+	TZ_Open();
+
+	u32 TZFileCnt = 0, TZTotalCnt = 0;
+	TZ_Stats(&TZFileCnt, &TZTotalCnt);
+
+	s64 NowTS = clock_ns();
+	printf("Offset to GMT is %lli (%s) tz transitions %i\n", TZ_Offset(NowTS), TZ_Zone(NowTS), TZFileCnt);
+
+	// check for valid config. any combination of time / bytes / packets
+	if (s_SplitMode == 0)
+	{
+		fprintf(stderr, "invalid config. no split type time/bytes/packets specified\n");
+		Help();
+		return false;
+	}
+	if ((s_SplitCalendar != SPLIT_CALENDAR_NONE) && (s_TargetTime != 0))
+	{
+		fprintf(stderr, "invalid config. --split-calendar and --split-time are exclusive\n");
+		return false;
+	}
+	if ((s_SplitMode & SPLIT_MODE_PACKET) && (s_TargetPkt == 0))
+	{
+		fprintf(stderr, "invalid config. packet split count must be > 0\n");
+		return false;
+	}
+	if ((s_ReorderWindow > 0) || (s_ReorderWindowPkt > 0))
+	{
+		s64 Period = (s_SplitCalendar != SPLIT_CALENDAR_NONE) ? 3600 * k1E9 : s_TargetTime;
+		if (!(s_SplitMode & SPLIT_MODE_TIME) || (s_ReorderWindow >= Period))
+		{
+			fprintf(stderr, "invalid config. reorder window requires --split-time longer than the window\n");
+			return false;
+		}
+	}
+	if (s_ReorderBufferMax > 0)
+	{
+		s_Reorder = Reorder_Create(s_ReorderBufferMax);
+	}
+	if ((s_ResumeMode != RESUME_NONE) && (s_CheckpointFile == NULL))
+	{
+		fprintf(stderr, "invalid config. --resume requires --checkpoint\n");
+		return false;
+	}
+
+	if (!FileName_Compile(s_FileNameTemplate))
+	{
+		fprintf(stderr, "invalid config. bad filename template\n");
+		return false;
+	}
+
+	// io_uring writes the file directly, so only valid for plain file output
+	if (s_OutputEngine == OUTPUT_ENGINE_URING)
+	{
+		if ((s_OutputMode != OUTPUT_MODE_CAT) || (strcmp(s_PipeCmd, "cat") != 0))
+		{
+			fprintf(stderr, "invalid config. --io-uring only supports direct file output without --pipe-cmd\n");
+			return false;
+		}
+		if ((s_UringDepth < 2) || (s_UringBufferSize < 4096) || (s_UringBufferSize % 4096))
+		{
+			fprintf(stderr, "invalid config. io_uring depth must be >= 2 and buffer size a multiple of 4KB\n");
+			return false;
+		}
+	}
+	// retention only manages local files
+	if (s_Retain)
+	{
+		if (s_OutputMode != OUTPUT_MODE_CAT)
+		{
+			fprintf(stderr, "invalid config. --retain-* only supports local file output\n");
+			return false;
+		}
+
+		// the pipe engine truncates via the shell redirect so there is nothing to reuse
+		if (s_RetainConfig.IsRecycle && (s_OutputEngine != OUTPUT_ENGINE_URING))
+		{
+			fprintf(stderr, "--retain-recycle requires --io-uring, deleting instead\n");
+			s_RetainConfig.IsRecycle = false;
+		}
+
+		// write failures are handled by reclaiming space, not by dying on a closed pipe
+		signal(SIGPIPE, SIG_IGN);
+
+		Retain_Open(&s_RetainConfig, s_OutFileName, s_FileNameSuffix);
+	}
+
+	if (s_Dedup) Dedup_Open(&s_DedupConfig);
+	if (s_Sample) Sample_Open(&s_SampleConfig);
+
+	if (s_PluginPath)
+	{
+		if (!Plugin_Open(s_PluginPath, s_PluginArg)) return false;
+	}
+
+	// calibrate the TSC for stage timing
+	if (s_Profile) Profile_Init();
+
+	// account time blocked on output so ring backups can be attributed
+	if (s_LXCRingPath)
+	{
+		s_OutputFlags |= OUTPUT_FLAG_BLOCKSTAT;
+		if (!s_Profile) CycleCalibration();
+	}
+
+	if (s_StatsShmPath)
+	{
+		s_StatsShm = ShmStats_Open(s_StatsShmPath);
+		if (!s_StatsShm) return false;
+	}
+
+	// hugepage backed buffers local to the cpu`s numa node
+	s_PoolBatch = Pool_Create("batch", BATCH_BUFFER_SIZE, BATCH_BUFFER_CNT, NUMANode);
+	assert(s_PoolBatch != NULL);
+
+	if (s_OutputEngine == OUTPUT_ENGINE_URING)
+	{
+		s_PoolOutput = Pool_Create("output", s_UringBufferSize, s_UringDepth, NUMANode);
+		assert(s_PoolOutput != NULL);
+	}
+	Output_Init(s_OutputEngine, s_OutputFlags, s_PoolOutput);
+
+	// raw splits are next to the output unless staged, only possible for local files
+	if (s_CompressWorker)
+	{
+		if (!s_CompressStage && (s_OutputMode != OUTPUT_MODE_CAT))
+		{
+			fprintf(stderr, "--compress-workers needs --compress-stage for non file output\n");
+			return false;
+		}
+		if (s_CheckpointFile)
+		{
+			fprintf(stderr, "--compress-workers can not be used with --checkpoint\n");
+			return false;
+		}
+		Compress_Open(s_CompressWorker, CompressDone);
+	}
+
+	if ((s_OutputMode == OUTPUT_MODE_SSH) && s_SSHMux) SSHMuxOpen();
+
+	// remote outputs spool locally, local ones dont need it
+	if (s_SpoolDir)
+	{
+		s_Spool = true;
+		switch (s_OutputMode)
+		{
+		case OUTPUT_MODE_RCLONE:
+			// output name is already the full rclone remote
+			s_UploadConfig.Mode		= UPLOAD_MODE_RCLONE;
+			break;
+
+		case OUTPUT_MODE_CURL:
+			sprintf(s_SpoolURL, "%s%s", s_CURLPath, s_CURLPrefix);
+			s_UploadConfig.Mode		= UPLOAD_MODE_CURL;
+			s_UploadConfig.CURLArg	= s_CURLArg;
+			break;
+
+		case OUTPUT_MODE_SSH:
+			sprintf(s_SpoolURL, "%s%s", s_SSHPath, s_SSHPrefix);
+			s_UploadConfig.Mode		= UPLOAD_MODE_SSH;
+			s_UploadConfig.SSHOpt	= s_SSHOpt;
+			s_UploadConfig.SSHHost	= s_SSHHost;
+			break;
+
+		default:
+			fprintf(stderr, "--spool only applies to rclone / curl / ssh output, ignored\n");
+			s_Spool = false;
+			break;
+		}
+		s_UploadConfig.URL = s_SpoolURL;
+		if (s_Spool) Upload_Open(&s_UploadConfig);
+	}
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// reset the split state and resume from the checkpoint. FIn is only used to seek a resumed
+// input, NULL when the caller owns the input
+
+static bool SplitStart(PCAPSplit_t* C, FILE* FIn)
+{
+	// force it to nsec pacp
+	s_HeaderMaster.Magic 		= PCAPHEADER_MAGIC_NANO;
+	s_HeaderMaster.Major 		= PCAPHEADER_MAJOR;
+	s_HeaderMaster.Minor 		= PCAPHEADER_MINOR;
+	s_HeaderMaster.TimeZone 	= 0;
+	s_HeaderMaster.SigFlag 	= 0;
+	s_HeaderMaster.SnapLen 	= 0xffff;
+	s_HeaderMaster.Link 		= 1;				// set as ethernet
+
+	// split stats
+	memset(C, 0, sizeof(PCAPSplit_t));
+	s_StartTS					= clock_ns();
+	C->LastTSC					= rdtsc();
+	C->StatusTSC				= g_ProfileEnable ? ns2tsc(1e9) : 2.5e9;	// calibrated 1 sec when profiling
+
+	// first packet always opens a split
+	memset(&s_Split, 0, sizeof(s_Split));
+	s_Split.Byte	 			= -1;
+	s_Split.Pkt	 				= -1;
+
+	// no no targettime rounderup was specified use default 1/4
+	if (s_TargetTimeRoundup == 0)
+	{
+		s_TargetTimeRoundup		=  s_TargetTime/4;
+	}
+
+	// every input byte past the header lands in a split in order
+	s_InputOffset				= sizeof(PCAPHeader_t);
+	s_InputPushOffset			= s_InputOffset;
+
+	if (s_ResumeMode != RESUME_NONE)
+	{
+		if (!Resume(FIn)) return false;
+	}
+	C->CheckpointSplit			= s_TotalSplit;
+	C->StatsSplit				= s_TotalSplit;
+
+	// packets come back out of the reorder buffer into here
+	C->Pkt						= Pool_Alloc(s_PoolBatch);
+	assert(C->Pkt);
+
+	C->IsOpen					= true;
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// one packet / NOP into the splitter, false on a fatal output error
+
+static bool SplitPush(PCAPSplit_t* C, s64 PCAPTS, PCAPPacket_t* PktHeader, bool IsNOP, bool IsRollRequest)
+{
+	// resumed without seeking, drop packets already written. packets sharing the last
+	// timestamp are only dropped up to the count already seen, the rest still go out
+	if (s_ResumeSkipTS != 0)
+	{
+		bool IsPkt = (PktHeader->LengthWire > 0);
+		if ((PCAPTS < s_ResumeSkipTS) || ((PCAPTS == s_ResumeSkipTS) && (!IsPkt || (s_ResumeSkipCnt > 0))))
+		{
+			if ((PCAPTS == s_ResumeSkipTS) && IsPkt) s_ResumeSkipCnt--;
+			s_ResumeSkipPkt++;
+			return true;
+		}
+		printf("Resume: skipped %lli packets\n", s_ResumeSkipPkt);
+		s_ResumeSkipTS = 0;
+	}
+
+	// idle input, move time forward to the wall clock so time splits still roll
+	if (IsNOP && s_WallClockRoll)
+	{
+		s64 NowTS = clock_ns();
+		if (NowTS > PCAPTS)
+		{
+			PCAPTS				= NowTS;
+			PktHeader->Sec		= PCAPTS / (u64)1e9;
+			PktHeader->NSec		= PCAPTS % (u64)1e9;
+		}
+	}
+
+	// hold packets back in the reorder buffer, the oldest comes out once its full
+	if (s_Reorder)
+	{
+		if (!Reorder_Push(s_Reorder, PCAPTS, (u8*)PktHeader, sizeof(PCAPPacket_t) + PktHeader->LengthCapture, IsRollRequest)) return true;
+		u8 IsRoll		= 0;
+		PCAPTS			= Reorder_Pop(s_Reorder, C->Pkt, &IsRoll);
+		PktHeader		= (PCAPPacket_t*)C->Pkt;
+		IsRollRequest	= IsRoll;
+	}
+
+	u64 SplitTSC = g_ProfileEnable ? rdtsc() : 0;
+	if (!SplitPacket(PCAPTS, PktHeader, IsRollRequest)) return false;
+	if (g_ProfileEnable) Profile_Add(PROFILE_SPLIT, rdtsc() - SplitTSC);
+
+	if (IsNOP && s_IdleFlush) SplitIdle();
+
+	// live stats every batch of packets and every new split
+	if (s_StatsShm && (((++C->StatsPktCnt & (STATS_SHM_BATCH - 1)) == 0) || (s_TotalSplit != C->StatsSplit)))
+	{
+		C->StatsSplit = s_TotalSplit;
+		StatsPublish(true);
+	}
+
+	// checkpoint every new split
+	if (s_CheckpointFile && (s_TotalSplit != C->CheckpointSplit))
+	{
+		C->CheckpointSplit	= s_TotalSplit;
+		C->IsCheckpoint		= true;
+	}
+	if (C->IsCheckpoint || C->IsCheckpointTmp) CheckpointPoll(C);
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// queue a packet read from the input. its input offsets are taken now, the reader has
+// moved past it by the time the batch is split
+
+static void BatchAdd(PCAPSplit_t* C, s64 PCAPTS, PCAPPacket_t* PktHeader, bool IsNOP)
+{
+	u32 i = C->BatchCnt++;
+	assert(i < PUSH_BATCH_MAX);
+
+	C->BatchPkt[i]		= PktHeader;
+	C->BatchTS[i]		= PCAPTS;
+	C->BatchNOP[i]		= IsNOP;
+	C->BatchOffset[i]	= s_InputPktOffset;
+	C->BatchEnd[i]		= s_InputOffset;
+}
+
+// route the queued packets through the plugin then split them. returns the number
+// split, less than queued is a fatal output error
+static u32 BatchPush(PCAPSplit_t* C)
+{
+	u32 PktCnt	= C->BatchCnt;
+	C->BatchCnt	= 0;
+
+	if (s_PluginPath)
+	{
+		u64 HookTSC = g_ProfileEnable ? rdtsc() : 0;
+		Plugin_Route((PCAPSplitPacket_t**)C->BatchPkt, C->BatchRoute, PktCnt);
+		if (g_ProfileEnable) Profile_Add(PROFILE_HOOK, rdtsc() - HookTSC);
+	}
+
+	for (int i=0; i < PktCnt; i++)
+	{
+		PCAPPacket_t* PktHeader = C->BatchPkt[i];
+		bool IsRollRequest = false;
+		if (s_PluginPath && (PktHeader->LengthWire > 0))
+		{
+			switch (C->BatchRoute[i])
+			{
+			case PCAPSPLIT_ROUTE_DROP:
+				// carry on as a NOP so time splits still advance
+				PktHeader->LengthWire		= 0;
+				PktHeader->LengthCapture	= 0;
+				s_DropPkt++;
+				break;
+
+			case PCAPSPLIT_ROUTE_ROLL:
+				IsRollRequest = true;
+				break;
+			}
+		}
+
+		s_InputPktOffset	= C->BatchOffset[i];
+		s_InputPushOffset	= C->BatchEnd[i];
+
+		if (!SplitPush(C, C->BatchTS[i], PktHeader, C->BatchNOP[i], IsRollRequest)) return i;
+	}
+	return PktCnt;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void StatsGet(PCAPSplitStats_t* Stats)
+{
+	Stats->TotalByte	= s_TotalByte;
+	Stats->TotalPkt		= s_TotalPkt;
+	Stats->DropPkt		= s_DropPkt;
+	Stats->TotalSplit	= s_TotalSplit;
+	Stats->LastTS		= s_LastPCAPTS;
+	Stats->FileName		= s_Split.FileName;
+}
+
+static void PluginStats(void)
+{
+	PCAPSplitStats_t Stats;
+	StatsGet(&Stats);
+	Plugin_Stats(&Stats);
+}
+
+//-------------------------------------------------------------------------------------------------
+// periodic status printing
+
+static void SplitPoll(PCAPSplit_t* C)
+{
+	// assumein ~2.5Ghz clock or so, just need some periodic printing
+	if ((rdtsc() - C->LastTSC) <= C->StatusTSC) return;
+
+	C->LastTSC = rdtsc();
+
+	u8 TimeStr[1024];
+	clock_date_t c	= ns2clock(s_LastPCAPTS);
+	sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
+
+	u64 TS = clock_ns();
+
+	double dT 		= (TS - C->LastPrintTS) / 1e9;
+	double dByte 	= s_TotalByte - C->LastPrintByte;
+	double dPacket 	= s_TotalPkt  - C->LastPrintPkt;
+	double Bps 		= (dByte * 8.0) / dT;
+	double Pps 		= dPacket / dT;
+
+	// pool occupancy
+	u32 PoolUsed = 0, PoolTotal = 0, OutputUsed = 0, OutputHigh = 0, OutputTotal = 0;
+	Pool_Stats(s_PoolBatch, &PoolUsed, NULL, &PoolTotal);
+	if (s_PoolOutput) Pool_Stats(s_PoolOutput, &OutputUsed, &OutputHigh, &OutputTotal);
+
+	// filesystem usage changes as deletes complete
+	if (s_Retain) Retain_Check();
+
+	// splits closed while the input is idle
+	Output_Poll();
+
+	if (s_ResyncCnt > 0)
+	{
+		printf("Resync: %lli resyncs %lli bytes skipped\n", s_ResyncCnt, s_ResyncByte);
+	}
+
+	if (s_LXCRingPath) RingStatus();
+	if (s_Sample) SampleStatus();
+	if (s_Dedup) DedupStatus();
+	if (s_Spool) UploadStatus();
+	if (s_CompressWorker) CompressStatus();
+
+	if (s_CheckpointFile)
+	{
+		if (s_Split.Out) Output_Flush(s_Split.Out);
+		C->IsCheckpoint = true;
+		CheckpointPoll(C);
+	}
+
+	printf("[%.3f H][%s] %s : Total Bytes %20lli %10lli %.3f GB Speed: %.3f Gbps %.3f Mpps : TotalSplit %i PCAPTS: %lli Pool %i/%i Output %i/%i (%i)\n", dT / (60*60),
+																															TimeStr,
+																															s_Split.FileName,
+																															s_TotalByte,
+																															s_TotalPkt,
+																															s_TotalByte / 1e9,
+																															Bps / 1e9,
+																															Pps / 1e6,
+																															s_TotalSplit,
+																															s_LastPCAPTS,
+																															PoolUsed, PoolTotal,
+																															OutputUsed, OutputTotal, OutputHigh);
+	if (g_ProfileEnable)
+	{
+		u8 ProfileStr[1024];
+		Profile_Status(ProfileStr);
+		printf("%s\n", ProfileStr);
+	}
+	if (s_StatsFile) StatsWrite();
+	if (s_PluginPath) PluginStats();
+
+	fflush(stdout);
+	fflush(stderr);
+
+	C->LastPrintTS 		= TS;
+	C->LastPrintByte 	= s_TotalByte;
+	C->LastPrintPkt 	= s_TotalPkt;
+}
+
+//-------------------------------------------------------------------------------------------------
+// drain the reorder buffer, close the last splits and wait for the background workers
+
+static void SplitFinish(PCAPSplit_t* C)
+{
+	// flush anything still held in the reorder buffer
+	PCAPPacket_t* PktHeader = (PCAPPacket_t*)C->Pkt;
+	while (s_Reorder && (Reorder_Count(s_Reorder) > 0))
+	{
+		u8 IsRoll = 0;
+		s64 PCAPTS = Reorder_Pop(s_Reorder, C->Pkt, &IsRoll);
+		if (!SplitPacket(PCAPTS, PktHeader, IsRoll)) break;
+	}
+
+	// final close and re-name
+	SplitClose(&s_SplitPrev, s_LastPCAPTS, true);
+	SplitClose(&s_Split, s_LastPCAPTS, true);
+	Output_Drain();
+
+	// wait for the last splits to compress
+	if (s_CompressWorker)
+	{
+		Compress_Close();
+		CompressReap();
+		CompressStatus();
+	}
+
+	if (s_ResyncCnt > 0)
+	{
+		printf("Resync: %lli resyncs %lli bytes skipped\n", s_ResyncCnt, s_ResyncByte);
+	}
+	if (s_IdleFlushCnt > 0)
+	{
+		printf("Idle: %lli splits closed by --idle-flush\n", s_IdleFlushCnt);
+	}
+
+	// nothing pending, a restart only skips what was processed
+	if (s_CheckpointFile && CheckpointWrite()) CheckpointCommit();
+
+	if (s_LXCRingPath) RingStatus();
+	if (s_Sample) SampleStatus();
+	if (s_Dedup) DedupStatus();
+
+	if (s_Retain)
+	{
+		u32 RetainCnt = 0;
+		u64 RetainByte = 0, RetainDelete = 0;
+		Retain_Stats(&RetainCnt, &RetainByte, &RetainDelete, NULL);
+		Retain_Close();
+
+		printf("Retain: Splits %i %.3f GB Expired %lli\n", RetainCnt, RetainByte / 1e9, RetainDelete);
+	}
+
+	if (g_ProfileEnable)
+	{
+		u8 ProfileStr[1024];
+		Profile_Status(ProfileStr);
+		printf("%s\n", ProfileStr);
+	}
+	if (s_StatsFile) StatsWrite();
+	if (s_StatsShm) StatsPublish(false);
+
+	if (s_PluginPath)
+	{
+		PluginStats();
+		Plugin_Close();
+	}
+
+	// remaining uploads finish before exit
+	if (s_Spool)
+	{
+		Upload_Close();
+		UploadStatus();
+	}
 
-				for (; i < strlen(UserName); i++)
-				{
-					u32 c = UserName[i];
-					sGID[GIDPos++] = c;
-				}
-				sGID[GIDPos] = 0;
+	// spooled ssh uploads run over the master, only stop it once theyre done
+	SSHMuxClose();
 
-				fprintf(stderr, "UID[%s] GID[%s]\n", sUID, sGID);
+	// single line summary for scripts / benchmarking
+	double dT = (clock_ns() - s_StartTS) / 1e9;
+	printf("Summary: Bytes %lli Pkts %lli Splits %i Time %.3f sec Speed %.3f Gbps %.3f Mpps\n", s_TotalByte, s_TotalPkt, s_TotalSplit, dT, s_TotalByte * 8.0 / dT / 1e9, s_TotalPkt / dT / 1e6);
 
-		    	s_FileNameUID		= atoi(sUID); 
-				s_FileNameGID		= atoi(sGID); 
+	Pool_Free(s_PoolBatch, C->Pkt);
+	C->IsOpen = false;
+}
 
-				// if its not a UID/GID number try it as a username/group string
-				if (s_FileNameUID == 0)
-				{
-					struct passwd *pwd 	= getpwnam(sUID);
-					if (pwd != NULL)
-					{
-		    			s_FileNameUID		= pwd->pw_uid;
-					}
-				}
-				if (s_FileNameGID == 0)
-				{
-					struct group *grp = getgrnam(sGID);
-					if (grp != NULL)
-					{
-		    			s_FileNameGID		= grp->gr_gid;
-					}
-				}
-			}
+//-------------------------------------------------------------------------------------------------
+// libpcapsplit
 
-			fprintf(stderr, "UserName (%s) %i:%i\n", UserName, s_FileNameUID, s_FileNameGID); 
-			i++;
-		}
-		else
-		{
-			fprintf(stderr, "unknown command [%s]\n", argv[i]);
-			return 0;
-		}
+PCAPSplit_t* PCAPSplit_Open(int argc, char* argv[])
+{
+	// all splitter state is module level and carries over from a previous run
+	if (s_ContextUsed)
+	{
+		fprintf(stderr, "PCAPSplit_Open: splitter already used, only one run per process\n");
+		return NULL;
 	}
+	s_ContextUsed = true;
 
-	// set cpu affinity
-	if (CPUListCnt > 0)
+	if (!SplitSetup(argc, argv)) return NULL;
+
+	// the caller owns the input
+	if (s_LXCRingPath)
 	{
-		cpu_set_t	MainCPUS;
-		CPU_ZERO(&MainCPUS);
+		fprintf(stderr, "invalid config. --ring is an input option, not valid for libpcapsplit\n");
+		return NULL;
+	}
 
-		for (int i=0; i < CPUListCnt; i++)
+	// no input stream to map checkpoint offsets back to
+	s_InputExact = false;
+
+	if (!SplitStart(&s_Context, NULL)) return NULL;
+
+	return &s_Context;
+}
+
+u32 PCAPSplit_Push(PCAPSplit_t* C, PCAPSplitPacket_t* Pkt[], u32 PktCnt)
+{
+	assert(C->IsOpen);
+
+	u32 Pos = 0;
+	while (Pos < PktCnt)
+	{
+		u32 Start = Pos;
+		for (; (Pos < PktCnt) && (C->BatchCnt < PUSH_BATCH_MAX); Pos++)
 		{
-			CPU_SET(CPUList[i], &MainCPUS);
+			PCAPPacket_t* PktHeader = (PCAPPacket_t*)Pkt[Pos];
+			s64 PCAPTS = (u64)PktHeader->Sec * ((u64)1e9) + (u64)PktHeader->NSec;
+
+			BatchAdd(C, PCAPTS, PktHeader, (PktHeader->LengthWire == 0));
 		}
-		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &MainCPUS);
+
+		u32 Done = BatchPush(C);
+		if (Done != Pos - Start) return Start + Done;
 	}
+	return PktCnt;
+}
+
+void PCAPSplit_Poll(PCAPSplit_t* C, PCAPSplitStats_t* Stats)
+{
+	assert(C->IsOpen);
+
+	SplitPoll(C);
+
+	if (Stats) StatsGet(Stats);
+}
+
+void PCAPSplit_Close(PCAPSplit_t* C)
+{
+	assert(C->IsOpen);
+
+	SplitFinish(C);
+}
+
+//-------------------------------------------------------------------------------------------------
+// pcap_split cli, reads pcap / FMAD chunked / lxc ring input and pushes it into the splitter
+
+#ifndef PCAPSPLIT_LIB
 
+int main(int argc, char* argv[])
+{
+	if (!SplitSetup(argc, argv)) return 0;
 
 	// setup signal hanlders
 	struct sigaction handler;
@@ -978,60 +3299,13 @@ int main(int argc, char* argv[])
 	sigaction (SIGBUS, 	&handler, NULL);
 	sigaction (SIGSEGV, &handler, NULL);
 
-	
-	// get the local timezone offset
-	// as pcap timestamps are always epoch
-  	time_t t = time(NULL);
- 	struct tm lt = {0};
-
-	localtime_r(&t, &lt);
-
-	s_TZOffset = (s64)lt.tm_gmtoff * 1e9;
-	printf("Offset to GMT is %lli (%s)\n", s_TZOffset, lt.tm_zone);
-
-	// check for valid config
-	switch (SplitMode)
-	{
-	case SPLIT_MODE_BYTE:
-	case SPLIT_MODE_TIME:
-		break;
-
-	default:
-		fprintf(stderr, "invalid config. no split type time/bytes specified\n");
-		Help();
-		return 0;
-	}
-
-	switch (FileNameMode)
-	{
-	case FILENAME_EPOCH_SEC:
-	case FILENAME_EPOCH_SEC_STARTEND:
-	case FILENAME_EPOCH_MSEC:
-	case FILENAME_EPOCH_USEC:
-	case FILENAME_EPOCH_NSEC:
-	case FILENAME_TSTR_HHMM:
-	case FILENAME_TSTR_HHMMSS:
-	case FILENAME_TSTR_HHMMSS_TZ:
-	case FILENAME_TSTR_HHMMSS_NS:
-	case FILENAME_TSTR_HHMMSS_SUB:
-	case FILENAME_STRFTIME:
-		break;
-
-	default:
-		fprintf(stderr, "invalid filename mode\n");
-		break;
-	}
-
-	FILE* FIn = stdin; 
+	FILE* FIn = stdin;
 	assert(FIn != NULL);
 
 	// work out the input file format
-	bool InputMode 		= INPUT_MODE_NULL;
+	u32 InputMode 		= INPUT_MODE_NULL;
 	u64 TScale 			= 0;
 
-	// master pcap header for output
-	PCAPHeader_t HeaderMaster;
-
 	// lxc ring as input
 	#ifdef FMADIO_LXCRING
 	if (s_LXCRingPath)
@@ -1055,83 +3329,61 @@ int main(int argc, char* argv[])
 	#endif
 	{
 		// read header
-		int rlen = fread(&HeaderMaster, 1, sizeof(HeaderMaster), FIn);
-		if (rlen != sizeof(HeaderMaster))
+		int rlen = fread(&s_HeaderMaster, 1, sizeof(s_HeaderMaster), FIn);
+		if (rlen != sizeof(s_HeaderMaster))
 		{
 			printf("Failed to read pcap header\n");
 			return 0;
 		}
 
 		// what kind of pcap
-		switch (HeaderMaster.Magic)
+		switch (s_HeaderMaster.Magic)
 		{
-		case PCAPHEADER_MAGIC_NANO: 
-			printf("PCAP Nano\n"); 
-			TScale 			= 1;    
+		case PCAPHEADER_MAGIC_NANO:
+			printf("PCAP Nano\n");
+			TScale 			= 1;
 			InputMode		= INPUT_MODE_PCAP;
 			break;
 
-		case PCAPHEADER_MAGIC_USEC: 
-			printf("PCAP Micro\n"); 
-			TScale 			= 1000; 
+		case PCAPHEADER_MAGIC_USEC:
+			printf("PCAP Micro\n");
+			TScale 			= 1000;
 			InputMode		= INPUT_MODE_PCAP;
 			break;
 
-		case PCAPHEADER_MAGIC_FMAD: 
+		case PCAPHEADER_MAGIC_FMAD:
 			fprintf(stderr, "FMAD Format Chunked\n");
-			TScale 			= 1; 
+			TScale 			= 1;
 			InputMode		= INPUT_MODE_FMAD;
 
 			break;
 		}
 	}
 
-	// force it to nsec pacp
-	HeaderMaster.Magic 		= PCAPHEADER_MAGIC_NANO;
-	HeaderMaster.Major 		= PCAPHEADER_MAJOR;
-	HeaderMaster.Minor 		= PCAPHEADER_MINOR;
-	HeaderMaster.TimeZone 	= 0;
-	HeaderMaster.SigFlag 	= 0;
-	HeaderMaster.SnapLen 	= 0xffff;
-	HeaderMaster.Link 		= 1;				// set as ethernet
-
-	// split stats
-	u64 StartTS					= clock_ns();
-	u64 LastTSC					= rdtsc(); 
-	u64 TotalByte				= 0;
-	u64 TotalPkt				= 0;
-	u32 TotalSplit				= 0;
-
-	u64 SplitByte	 			= -1;	
-	u64 SplitPkt	 			= -1;	
-	u64 SplitStartTS			= 0;
-	u64 SplitStartPCAPTS		= 0;
-	FILE* OutFile 				= NULL;
-
-
-	// no no targettime rounderup was specified use default 1/4
-	if (TargetTimeRoundup == 0)
+	if ((s_IdleFlush || s_WallClockRoll) && (InputMode == INPUT_MODE_PCAP))
 	{
-		TargetTimeRoundup		=  TargetTime/4; 
+		fprintf(stderr, "--idle-flush / --wallclock-roll need lxc ring or FMAD chunked input, ignored\n");
+		s_IdleFlush		= 0;
+		s_WallClockRoll	= false;
 	}
 
+	// every input byte past the header lands in a split in order
+	s_InputExact				= (InputMode == INPUT_MODE_PCAP) && (s_Reorder == NULL);
 
-	u64 LastPCAPTS				= 0;
-	u64 SplitTS					= 0;				// next boudnary condition
-	u64 LastSplitTS				= 0;				// last boundary condition 
+	PCAPSplit_t* C = &s_Context;
+	if (!SplitStart(C, FIn)) return 0;
 
-	u8* 			Pkt			= malloc(1024*1024);	
+	// packets are read back to back into the batch buffer
+	u8* Pkt					= Pool_Alloc(s_PoolBatch);
 	assert(Pkt);
 
-	PCAPPacket_t*	PktHeader	= (PCAPPacket_t*)Pkt;
-
-	u8 FileName[1024];			// filename of the final output
-	u8 FileNamePending[1024];	// filename of the currently active write
+	u32 BatchPos			= 0;
+	u64 BatchMax			= Pool_BufferSize(s_PoolBatch);
 
 	// chunked fmad buffer
 	u32 FMADChunkBufferPos	= 0;
 	u32 FMADChunkBufferMax	= 0;
-	u8* FMADChunkBuffer 	= NULL; 
+	u8* FMADChunkBuffer 	= NULL;
 
 	u32 FMADChunkPktCnt		= 0;
 	u32 FMADChunkPktMax		= 0;
@@ -1145,27 +3397,34 @@ int main(int argc, char* argv[])
 	case INPUT_MODE_FMAD:
 		FMADChunkBufferPos	= 0;
 		FMADChunkBufferMax	= 0;
-		FMADChunkBuffer		= malloc(1024*1024);
+		FMADChunkBuffer		= Pool_Alloc(s_PoolBatch);
 		assert(FMADChunkBuffer != NULL);
 		break;
 	}
 
-	// stats
-	u64 LastPrintTS 		= 0;
-	u64 LastPrintByte 		= 0;
-	u64 LastPrintPkt 		= 0;
+	// lxc ring sampling
+	u64 RingSampleCnt		= 0;
+	u64 RingDegradeSeq		= 0;
 
 	bool IsExit = false;
+	bool IsError = false;
 	while ((!IsExit) || g_SignalExit)
 	{
+		PCAPPacket_t* PktHeader = (PCAPPacket_t*)(Pkt + BatchPos);
+
 		s64 PCAPTS;
+		bool IsNOP = false;									// input idle, no packet
+		u64 InputTSC = g_ProfileEnable ? rdtsc() : 0;
+
 		switch (InputMode)
 		{
 		// standard pcap mode
 		case INPUT_MODE_PCAP:
 		{
+			s_InputPktOffset = (s_InputExact && (s_PacketChomp == 0)) ? s_InputOffset : -1;
+
 			// header 
-			int rlen = fread(PktHeader, 1, sizeof(PCAPPacket_t), FIn);
+			int rlen = InputRead(PktHeader, sizeof(PCAPPacket_t), FIn);
 			if (rlen != sizeof(PCAPPacket_t))
 			{
 				printf("Invalid packet read size: %i (%i)\n", rlen, errno);
@@ -1176,19 +3435,37 @@ int main(int argc, char* argv[])
 			// validate size
 			if ((PktHeader->LengthCapture == 0) || (PktHeader->LengthCapture > 128*1024)) 
 			{
-				printf("Invalid packet length: %i : %s\n", PktHeader->LengthCapture, FormatTS(LastPCAPTS) );
-				IsExit = true;
-				break;
+				// resync checks timestamps against the last split packet, split whats queued first
+				u32 PktCnt = C->BatchCnt;
+				if (BatchPush(C) != PktCnt)
+				{
+					IsError = true;
+					IsExit = true;
+					break;
+				}
+
+				printf("Invalid packet length: %i : %s\n", PktHeader->LengthCapture, FormatTS(s_LastPCAPTS) );
+
+				// scan forward to the next valid packet
+				if (!InputResync(FIn, PktHeader, (TScale == 1) ? 1e9 : 1e6))
+				{
+					IsExit = true;
+					break;
+				}
+				s_InputPktOffset = (s_InputExact && (s_PacketChomp == 0)) ? s_InputOffset : -1;
+
+				InputRead(PktHeader, sizeof(PCAPPacket_t), FIn);
 			}
 
 			// payload
-			rlen = fread(PktHeader + 1, 1, PktHeader->LengthCapture, FIn);
+			rlen = InputRead(PktHeader + 1, PktHeader->LengthCapture, FIn);
 			if (rlen != PktHeader->LengthCapture)
 			{
 				printf("payload read fail %i (%i) expect %i\n", rlen, errno, PktHeader->LengthCapture);
 				IsExit = true;
 				break;
 			}
+			s_InputOffset += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
 
 			// pcap timestamp
 			PCAPTS = (u64)PktHeader->Sec * ((u64)1e9) + (u64)PktHeader->NSec * TScale;
@@ -1203,6 +3480,7 @@ int main(int argc, char* argv[])
 				FMADHeader_t Header;
 
 				u32 Timeout = 0; 
+				bool IsIdle = false;
 				while (true)
 				{
 					int rlen = fread(&Header, 1, sizeof(Header), FIn);
@@ -1214,8 +3492,30 @@ int main(int argc, char* argv[])
 					}
 
 					if (Header.PktCnt > 0) break;
+
+					// empty chunks are the capture keep alive, pass them on as NOPs
+					if (s_IdleFlush || s_WallClockRoll)
+					{
+						IsIdle = true;
+						break;
+					}
 					assert(Timeout++ < 1e6);
 				}
+				if (IsExit) break;
+
+				if (IsIdle)
+				{
+					// time of the last packet read, it may still be queued
+					s64 LastTS					= (C->BatchCnt > 0) ? C->BatchTS[C->BatchCnt - 1] : s_LastPCAPTS;
+
+					IsNOP						= true;
+					PCAPTS 						= (Header.TSEnd > LastTS) ? Header.TSEnd : LastTS;
+					PktHeader->LengthWire		= 0;
+					PktHeader->LengthCapture	= 0;
+					PktHeader->Sec				= PCAPTS / (u64)1e9;
+					PktHeader->NSec				= PCAPTS % (u64)1e9;
+					break;
+				}
 
 				// sanity checks
 				assert(Header.Length < 1024*1024);
@@ -1225,6 +3525,7 @@ int main(int argc, char* argv[])
 				if (rlen != Header.Length)
 				{
 					fprintf(stderr, "FMADHeader payload read fail: %i %i : %i\n", rlen, Header.Length, errno, strerror(errno));
+					IsExit = true;
 					break;
 				}
 
@@ -1258,6 +3559,8 @@ int main(int argc, char* argv[])
 		#ifdef FMADIO_LXCRING
 		case INPUT_MODE_LXCRING:
 		{
+			if ((RingSampleCnt++ & (RING_SAMPLE_BATCH - 1)) == 0) RingSample();
+
 			// fetch packet from ring without blocking
 			int ret = FMADPacket_RecvV1(s_LXCRing, 
 										true, 
@@ -1272,401 +3575,77 @@ int main(int argc, char* argv[])
 				break;
 			}
 			//printf("got packet:%i\n", PktHeader->LengthWire);
+			IsNOP = (PktHeader->LengthWire == 0);
 
 			//set packet header
 			PktHeader->Sec		= PCAPTS / (u64)1e9;	
 			PktHeader->NSec		= PCAPTS % (u64)1e9;	
-		}
-		break;
-		#endif
 
-		default:
-			assert(false);
-			break;
-		}
-
-		//no/invalid data so break here
-		if (IsExit) break;
-
-		// init the roll period
-		if (!s_RollPeriodSetup)
-		{
-			s_RollPeriodSetup = true;
-
-			// calcuclate pct within the roll the packet is
-			//s64 PktRollModulo = PCAPTS %  s_RollPeriod;
-			//float Pct = PktRollModulo / (float)s_RollPeriod;
-			//printf("roll period setup:%.3fmin  Nano Modulo:%lli Pct%:%.3f FirstPkt:%s\n", s_RollPeriod/60e9, PktRollModulo, Pct, FormatTS(PCAPTS));
-
-			// calculat the next roll time. by adding 10% of the roll period (if pkts are slightly before roll time)
-			// to the packet time and rounding up
-			s_RollLocalTS = (PCAPTS + 0.10 * s_RollPeriod + s_TZOffset) / s_RollPeriod;
-			s_RollLocalTS += 1; 
-			s_RollLocalTS *= s_RollPeriod; 
-
-			printf("RollTime: %lli %s\n", s_RollLocalTS, FormatTS(s_RollLocalTS));
-		}
-
-		// split mode
-		bool NewSplit = false;
-		switch (SplitMode)
-		{
-		case SPLIT_MODE_BYTE:
-
-			// next split ? 
-			if (SplitByte > TargetByte)
+			// ring is backing up, shed output bytes rather than lose whole bursts
+			if (s_RingDegradeActive && (PktHeader->LengthWire > 0))
 			{
-				// close file and rename
-				if (OutFile)
+				switch (s_RingDegradeMode)
 				{
-					fclose(OutFile);
-
-					u64 TS = clock_ns();
-
-					// log the split 
-					double dT = (TS - StartTS) / 1e9;
-					u8 TimeStr[1024];
-					clock_date_t c	= ns2clock(PCAPTS);
-					sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
-
-					s64 SplitDT 		= TS - SplitStartTS; 
-					s64 SplitPCAPDT 	= PCAPTS - SplitStartPCAPTS; 
-
-					printf("[%.3f H][%s] %s : Finished : Split Bytes %16lli (%.3f GB) Split Pkts:%10lli WallTime:%20lli PCAPTime:%20lli\n", dT / (60*60), TimeStr, FileName, SplitByte, SplitByte / 1e9, SplitPkt, SplitDT, SplitPCAPDT);
-
-					// run local script for every closed split
-					if (s_ScriptClose)
+				case RING_DEGRADE_SLICE:
+					if (PktHeader->LengthCapture > s_RingDegradeArg)
 					{
-						// filename description
-						u8 Desc[4096];
-						GenerateDescription(Desc, OutputMode, FileName);
-
-						// log the number of packets and total size
-						u8 Cmd[4096];	
-						sprintf(Cmd, "%s \"%s\" %lli %lli %lli %lli %lli %lli",  	s_ScriptCloseCmd,
-																					Desc,
-																					SplitByte,
-																					SplitPkt,
-																					SplitDT,
-																					SplitPCAPDT,
-																					SplitTS,
-																					LastPCAPTS
-						);
-
-						printf("Script [%s]\n", Cmd);
-						system(Cmd);
+						PktHeader->LengthCapture = s_RingDegradeArg;
+						s_RingDegradePkt++;
 					}
+					break;
 
-					// rename to file name 
-					RenameFile(OutputMode, FileNamePending, FileName);
-				}
-
-				// run local new script 
-				if (s_ScriptNew)
-				{
-					printf("Script [%s]\n", s_ScriptNewCmd);
-					system(s_ScriptNewCmd);
-				}
-
-				GenerateFileName(FileNameMode, FileName, OutFileName, PCAPTS, SplitTS);
-				sprintf(FileNamePending, "%s.pending", FileName);
-
-				u8 Cmd[16*1024];
-				GeneratePipeCmd(Cmd, OutputMode, FileNamePending);
-
-				printf("[%s]\n", Cmd);
-				OutFile 		= popen(Cmd, "w");
-				if (!OutFile)
-				{
-					printf("OutputFilename is invalid [%s] %i %s\n", FileName, errno, strerror(errno));
-					break;	
-				}
-
-				fwrite(&HeaderMaster, 1, sizeof(HeaderMaster), OutFile);	
-				fflush(OutFile);
-
-				SplitTS		= PCAPTS;
-
-				SplitByte 	= 0;
-				SplitPkt 	= 0;
-				NewSplit 	= true;
-			}
-			break;
-
-		case SPLIT_MODE_TIME:
-			{
-				bool IsNoSplit = false;
-
-				//if it has a roll position
-				if (s_RollLocalTS != 0)
-				{
-					// position wrt to split time
-					float Pct = (s_RollLocalTS - (PCAPTS + s_TZOffset)) / (float)s_RollPeriod;
-
-					// overflow into the next split
-					if (Pct <= 0.0)
+				case RING_DEGRADE_SAMPLE:
+					// sampled out packets become NOPs so time splits still advance
+					if ((++RingDegradeSeq % s_RingDegradeArg) != 0)
 					{
-						static u64 DisablePktCnt = 0;
-
-						//dont split let the packets bleed over
-						IsNoSplit = true;
-
-						// log only the first 10K disables 
-						DisablePktCnt++;
-						if (DisablePktCnt < 10000)
-						{
-							printf("Disable splitter:%f : %lli %lli %lli\n", Pct, s_RollLocalTS,  (PCAPTS + s_TZOffset), s_RollPeriod, DisablePktCnt);
-						}
+						PktHeader->LengthWire		= 0;
+						PktHeader->LengthCapture	= 0;
+						s_RingDegradePkt++;
+						s_DropPkt++;
 					}
+					break;
 				}
+			}
+		}
+		break;
+		#endif
 
-				// if pcap time is over the split 
-				// or the pcap time has jumped back negative substanially
-				s64 dTS = PCAPTS - SplitTS;
-				if (((dTS > TargetTime) || (dTS < -TargetTime))  && (!IsNoSplit))
-				{
-					// is it the first split
-					bool IsFirstSplit = (SplitTS == 0);
-
-					// save previous boundary
-					LastSplitTS = SplitTS;
-
-					// round up the last 1/XXX (default 4) of the time target
-					// this can be overwriten with --split-time-roundup  
-					// as the capture processes does not split preceisely at 0.00000000000
-					// thus allow for some variance
-					SplitTS = ((PCAPTS + TargetTimeRoundup) / TargetTime);
-					SplitTS *= TargetTime;
-
-					// create null PCAPs for anything missing 
-
-					// close file and rename
-					if (OutFile)
-					{
-						fclose(OutFile);
-
-						u64 TS = clock_ns();
-
-						// log the number of packets and total size
-						double dT = (TS - StartTS) / 1e9;
-						u8 TimeStr[1024];
-						clock_date_t c	= ns2clock(PCAPTS);
-						sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
-
-
-						s64 SplitDT 		= TS - SplitStartTS; 
-						s64 SplitPCAPDT 	= PCAPTS - SplitStartPCAPTS; 
-
-						printf("[%.3f H][%s] %s : Finished : Split Bytes %16lli (%.3f GB) Split Pkts:%10lli WallTime:%20lli PCAPTime:%20lli\n", dT / (60*60), TimeStr, FileName, SplitByte, SplitByte / 1e9, SplitPkt, SplitDT, SplitPCAPDT);
-
-						// run local script for every closed split
-						if (s_ScriptClose)
-						{
-							u8 Cmd[4096];	
-							sprintf(Cmd, "%s %s %lli %lli %lli %lli %lli %lli %lli %lli %lli",
-																				s_ScriptCloseCmd,
-																				FileName,
-
-																				SplitByte,
-																				SplitPkt,
-
-																				SplitDT,
-																				SplitPCAPDT,
-
-																				LastSplitTS,
-																				SplitTS,
-
-																				SplitStartPCAPTS,
-																				LastPCAPTS,
-
-																				PCAPTS
-							);
-
-							printf("Script [%s]\n", Cmd);
-							system(Cmd);
-						}
-
-						// rename to file name 
-						RenameFile(OutputMode, FileNamePending, FileName);
-
-						// change open
-						if (s_FileNameUID)
-						{
-							//fprintf(stderr, "chown\n");
-							chown(FileName, s_FileNameUID, s_FileNameGID); 
-						}
-					}
-
-					// run local new script 
-					if (s_ScriptNew)
-					{
-						printf("Script [%s]\n", s_ScriptNewCmd);
-						system(s_ScriptNewCmd);
-					}
-
-					// generate filename for output
-
-					u64 SplitTSStart 	= SplitTS;
-					u64 SplitTSStop		= SplitTS+TargetTime;
-
-					GenerateFileName(FileNameMode, FileName, OutFileName, SplitTSStart, SplitTSStop);
-					sprintf(FileNamePending, "%s.pending", FileName);
+		default:
+			assert(false);
+			break;
+		}
 
-					// generate pipe
-					u8 Cmd[4095];
-					GeneratePipeCmd(Cmd, OutputMode, FileNamePending);
-					printf("[%s]\n", Cmd);
-					OutFile 		= popen(Cmd, "w");
-					if (!OutFile)
-					{
-						printf("OutputFilename is invalid [%s]\n", FileName);
-						break;	
-					}	
+		//no/invalid data so break here
+		if (IsExit) break;
 
-					//write pcap header
-					fwrite(&HeaderMaster, 1, sizeof(HeaderMaster), OutFile);	
+		if (g_ProfileEnable) Profile_Add(PROFILE_INPUT, rdtsc() - InputTSC);
 
-					SplitByte 	= 0;
-					SplitPkt 	= 0;
-					NewSplit 	= true;
-				}
-			}
-			break;
-		}
+		// queue it, idle NOPs go straight through so idle handling isnt held back
+		BatchAdd(C, PCAPTS, PktHeader, IsNOP);
+		BatchPos += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
 
-		//if its a valid packet (e.g dont write NOP packets to disk)
-		if (PktHeader->LengthWire > 0)
+		if (IsNOP || (C->BatchCnt == PUSH_BATCH_MAX) || (BatchPos + sizeof(PCAPPacket_t) + 128*1024 > BatchMax))
 		{
-			// optionally chomp packets before outputing
-			PktHeader->LengthWire		-= s_PacketChomp; 
-			PktHeader->LengthCapture	-= s_PacketChomp; 
+			BatchPos = 0;
 
-			// write output
-			int wlen = fwrite(Pkt, 1, sizeof(PCAPPacket_t) + PktHeader->LengthCapture, OutFile);
-			if (wlen != sizeof(PCAPPacket_t) + PktHeader->LengthCapture)
+			u32 PktCnt = C->BatchCnt;
+			if (BatchPush(C) != PktCnt)
 			{
-				printf("write failure. possibly out of disk space\n");
+				IsError = true;
 				break;
 			}
-
-			SplitByte += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
-			SplitPkt  += 1; 
-
-			TotalByte += sizeof(PCAPPacket_t) + PktHeader->LengthCapture;
-			TotalPkt  += 1; 
-		}	
-		// use the NOP packets to update the timestamp
-		LastPCAPTS = PCAPTS;
-
-		if (NewSplit)
-		{
-			TotalSplit++;
-
-			SplitStartTS		= clock_ns();
-			SplitStartPCAPTS	= PCAPTS; 
-
-			u8 TimeStr[1024];
-			clock_date_t c	= ns2clock(PCAPTS);
-			sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
-
-			double dT = (clock_ns() - StartTS) / 1e9;
-			double Bps = (TotalByte * 8.0) / dT; 
-			printf("[%.3f H][%s] %s : Total Bytes %.3f GB Speed: %.3f Gbps : New Split\n", dT / (60*60), TimeStr, FileName, TotalByte / 1e9, Bps / 1e9);
-			fflush(stdout);
-			fflush(stderr);
-		}
-
-		// assumein ~2.5Ghz clock or so, just need some periodic printing 
-		if ((rdtsc() - LastTSC) > 2.5*1e9) 
-		{
-			LastTSC = rdtsc();
-
-			u8 TimeStr[1024];
-			clock_date_t c	= ns2clock(LastPCAPTS);
-			sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
-
-			u64 TS = clock_ns();
-
-			double dT 		= (TS - LastPrintTS) / 1e9; 
-			double dByte 	= TotalByte - LastPrintByte; 
-			double dPacket 	= TotalPkt  - LastPrintPkt; 
-			double Bps 		= (dByte * 8.0) / dT; 
-			double Pps 		= dPacket / dT; 
-			printf("[%.3f H][%s] %s : Total Bytes %20lli %10lli %.3f GB Speed: %.3f Gbps %.3f Mpps : TotalSplit %i PCAPTS: %lli\n", dT / (60*60), 
-																																	TimeStr, 
-																																	FileName, 
-																																	TotalByte, 
-																																	TotalPkt, 
-																																	TotalByte / 1e9, 
-																																	Bps / 1e9, 
-																																	Pps / 1e6, 
-																																	TotalSplit,
-																																	PCAPTS);
-			fflush(stdout);
-			fflush(stderr);
-
-			LastPrintTS 	= TS;
-			LastPrintByte 	= TotalByte;
-			LastPrintPkt 	= TotalPkt;
+			SplitPoll(C);
 		}
 	}
 
-	// final close and re-name
-	if (OutFile)
-	{
-		fclose(OutFile);
-
-		u64 TS = clock_ns();
-
-		// log the number of packets and total size
-		double dT = (TS - StartTS) / 1e9;
-		u8 TimeStr[1024];
-		clock_date_t c	= ns2clock(LastPCAPTS);
-		sprintf(TimeStr, "%04i-%02i-%02i %02i:%02i:%02i", c.year, c.month, c.day, c.hour, c.min, c.sec);
-
-		s64 SplitDT 		= TS - SplitStartTS; 
-		s64 SplitPCAPDT 	= LastPCAPTS - SplitStartPCAPTS; 
-
-		printf("[%.3f H][%s] %s : Finished : Split Bytes %16lli (%.3f GB) Split Pkts:%10lli WallTime:%20lli PCAPTime:%20lli close\n", dT / (60*60), TimeStr, FileName, SplitByte, SplitByte / 1e9, SplitPkt, SplitDT, SplitPCAPDT);
-
-		// run local script for every closed split
-		if (s_ScriptClose)
-		{
-			u8 Cmd[4096];	
-			sprintf(Cmd, "%s %s %lli %lli %lli %lli %lli %lli %lli %lli %lli",
-																s_ScriptCloseCmd,
-																FileName,
-
-																SplitByte,
-																SplitPkt,
+	// whatever was queued when the input ended
+	if (!IsError) BatchPush(C);
 
-																SplitDT,
-																SplitPCAPDT,
-
-																LastSplitTS,
-																SplitTS,
-
-																SplitStartPCAPTS,
-																LastPCAPTS,
-
-																LastPCAPTS
-			);
-
-			printf("Script [%s]\n", Cmd);
-			system(Cmd);
-		}
-
-		RenameFile(OutputMode, FileNamePending, FileName);
-
-		// rename the last file 
-		if (s_FileNameUID)
-		{
-			fprintf(stderr, "chown last file\n");
-			chown(FileName, s_FileNameUID, s_FileNameGID); 
-		}
-	}
+	SplitFinish(C);
 
 	printf("Complete\n");
 
 	return 0;
 }
+
+#endif
@@ -0,0 +1,710 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// split output writers
+//
+// pipe  : original popen("cat > file") path, used for compression / rclone / curl / ssh
+// uring : io_uring engine for the direct to disk case. packets are copied into a set of
+//         aligned buffers, each full buffer is queued as a single write at its file offset
+//         so the main loop never blocks in write(2). only when every buffer is in flight
+//         do we wait for a completion. fdatasync is issued once per split at close, and
+//         the close itself finishes in the background, see Output_Close.
+//
+// for TB scale runs the page cache is kept flat either by opening with O_DIRECT (only the
+// final tail is padded to the block size then truncated back) or, when O_DIRECT is not
+// supported by the filesystem, by queueing sync_file_range + fadvise(DONTNEED) a couple of
+// windows behind the write head
+//
+// write buffers are taken from a hugepage pool while being filled / in flight and returned
+// on completion, so pool occupancy is the current write backlog
+//
+// io_uring is driven via raw syscalls to avoid a liburing dependency
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "fTypes.h"
+#include "output.h"
+#include "pool.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define URING_TAG_CTRL					(1ULL<<63)			// user_data tag for fsync / sync range / fadvise ops
+
+#define URING_DIRECT_ALIGN				4096				// O_DIRECT block alignment
+#define URING_DROP_WINDOW				kMB(8)				// writeback + evict granularity
+
+typedef struct
+{
+	u8*					Buffer;								// pool buffer while busy
+	u32					Length;								// bytes valid in the buffer
+	u32					Pos;								// bytes written so far (short write resubmit)
+	u64					Offset;								// file offset of the buffer
+	struct Output_t*	Owner;								// which output this buffer belongs to
+	bool				IsBusy;								// being filled or in flight
+} UringBuffer_t;
+
+typedef struct Output_t
+{
+	u32					Engine;
+
+	FILE*				Pipe;								// pipe engine
+
+	int					FD;									// uring engine file handle
+	s32					BufferIndex;						// buffer currently being filled, -1 for none
+	u64					Offset;								// next file offset to queue
+	u64					Size;								// logical bytes written
+	u32					InFlight;							// ops in flight for this output
+	int					Error;								// sticky errno from completions
+
+	bool				IsDirect;							// opened with O_DIRECT
+	bool				IsTruncate;							// reused file, trim the old tail at close
+	bool				IsDropCache;						// evict page cache behind the write head
+	u64					DropOffset;							// start of the next window to writeback
+
+	bool				IsClosing;							// Output_Close called, finishing in the background
+	bool				IsSyncQueued;						// writes done, final fdatasync queued
+	Output_Done_f*		Done;								// called once closed
+	void*				DoneUser;
+	struct Output_t*	CloseNext;							// closing list
+	u64					CloseSeq;							// order Output_Close was called in
+
+} Output_t;
+
+static u32				s_Engine			= OUTPUT_ENGINE_PIPE;
+static u32				s_Flags				= 0;
+static u64				s_BlockTSC			= 0;				// cycles spent waiting on output
+
+// ring state
+static int				s_UringFD			= -1;
+static u32				s_UringEntries		= 0;
+
+static volatile u32*	s_SQHead			= NULL;
+static volatile u32*	s_SQTail			= NULL;
+static u32				s_SQMask			= 0;
+static u32*				s_SQArray			= NULL;
+static struct io_uring_sqe*	s_SQE			= NULL;
+static u32				s_SQPending			= 0;				// sqe`s queued but not submitted
+
+static volatile u32*	s_CQHead			= NULL;
+static volatile u32*	s_CQTail			= NULL;
+static u32				s_CQMask			= 0;
+static struct io_uring_cqe*	s_CQE			= NULL;
+
+// write buffers
+static struct Pool_t*	s_Pool				= NULL;
+static UringBuffer_t*	s_Buffer			= NULL;
+static u32				s_BufferCnt			= 0;
+static u32				s_BufferSize		= 0;
+static u32				s_BufferNext		= 0;				// round robin search start
+
+static Output_t*		s_CloseList			= NULL;				// outputs waiting for their writes / fdatasync
+static u64				s_CloseSeq			= 0;				// closes started
+
+//---------------------------------------------------------------------------------------------
+
+static int sys_io_uring_setup(u32 Entries, struct io_uring_params* p)
+{
+	return syscall(__NR_io_uring_setup, Entries, p);
+}
+
+static int sys_io_uring_enter(int FD, u32 Submit, u32 MinComplete, u32 Flags)
+{
+	return syscall(__NR_io_uring_enter, FD, Submit, MinComplete, Flags, NULL, 0);
+}
+
+//---------------------------------------------------------------------------------------------
+
+static int Uring_Setup(u32 Depth, u32 BufferSize)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	// worst case every buffer is in flight, each with the writeback + evict ops for every
+	// drop window it crosses, plus fsync`s for the outputs being closed
+	u32 Windows = (BufferSize + URING_DROP_WINDOW - 1) / URING_DROP_WINDOW;
+	u32 Entries = 1;
+	while (Entries < Depth * (1 + 3 * Windows) + 8) Entries <<= 1;
+
+	s_UringFD = sys_io_uring_setup(Entries, &p);
+	if (s_UringFD < 0)
+	{
+		fprintf(stderr, "io_uring_setup failed %i %s\n", errno, strerror(errno));
+		return -1;
+	}
+	s_UringEntries = p.sq_entries;
+
+	u8* SQ = mmap(0, p.sq_off.array + p.sq_entries * sizeof(u32), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_UringFD, IORING_OFF_SQ_RING);
+	u8* CQ = mmap(0, p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_UringFD, IORING_OFF_CQ_RING);
+	s_SQE  = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s_UringFD, IORING_OFF_SQES);
+	if ((SQ == MAP_FAILED) || (CQ == MAP_FAILED) || (s_SQE == MAP_FAILED))
+	{
+		fprintf(stderr, "io_uring mmap failed %i %s\n", errno, strerror(errno));
+		close(s_UringFD);
+		s_UringFD = -1;
+		return -1;
+	}
+
+	s_SQHead	= (u32*)(SQ + p.sq_off.head);
+	s_SQTail	= (u32*)(SQ + p.sq_off.tail);
+	s_SQMask	= *(u32*)(SQ + p.sq_off.ring_mask);
+	s_SQArray	= (u32*)(SQ + p.sq_off.array);
+
+	s_CQHead	= (u32*)(CQ + p.cq_off.head);
+	s_CQTail	= (u32*)(CQ + p.cq_off.tail);
+	s_CQMask	= *(u32*)(CQ + p.cq_off.ring_mask);
+	s_CQE		= (struct io_uring_cqe*)(CQ + p.cq_off.cqes);
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+
+// submit pending sqe`s and optionally wait for completions
+static void Uring_Enter(u32 MinComplete)
+{
+	if ((s_SQPending == 0) && (MinComplete == 0)) return;
+
+	u64 TSC = (MinComplete > 0) ? rdtsc() : 0;
+	while (true)
+	{
+		int ret = sys_io_uring_enter(s_UringFD, s_SQPending, MinComplete, (MinComplete > 0) ? IORING_ENTER_GETEVENTS : 0);
+		if (ret >= 0)
+		{
+			s_SQPending -= ret;
+			break;
+		}
+		if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) continue;
+
+		fprintf(stderr, "io_uring_enter failed %i %s\n", errno, strerror(errno));
+		assert(false);
+	}
+	if (TSC != 0) s_BlockTSC += rdtsc() - TSC;
+}
+
+// make room for Count sqe`s. the ring is sized so this normally never submits, but
+// submitting early is always safe as sqe slots are released on submit not completion
+static void Uring_SQEReserve(u32 Count)
+{
+	u32 Head = __atomic_load_n(s_SQHead, __ATOMIC_ACQUIRE);
+	if (s_UringEntries - (*s_SQTail - Head) >= Count) return;
+
+	Uring_Enter(0);
+
+	Head = __atomic_load_n(s_SQHead, __ATOMIC_ACQUIRE);
+	assert(s_UringEntries - (*s_SQTail - Head) >= Count);
+}
+
+// next free sqe
+static struct io_uring_sqe* Uring_SQE(void)
+{
+	Uring_SQEReserve(1);
+
+	u32 Tail = *s_SQTail;
+
+	u32 Index = Tail & s_SQMask;
+	struct io_uring_sqe* SQE = &s_SQE[Index];
+	memset(SQE, 0, sizeof(*SQE));
+
+	s_SQArray[Index] = Index;
+	__atomic_store_n(s_SQTail, Tail + 1, __ATOMIC_RELEASE);
+
+	s_SQPending++;
+	return SQE;
+}
+
+static void Uring_QueueWrite(u32 Index)
+{
+	UringBuffer_t* B = &s_Buffer[Index];
+
+	struct io_uring_sqe* SQE = Uring_SQE();
+	SQE->opcode		= IORING_OP_WRITE;
+	SQE->fd			= B->Owner->FD;
+	SQE->addr		= (u64)(B->Buffer + B->Pos);
+	SQE->len		= B->Length - B->Pos;
+	SQE->off		= B->Offset + B->Pos;
+	SQE->user_data	= Index;
+
+	B->Owner->InFlight++;
+}
+
+//---------------------------------------------------------------------------------------------
+// background close. once the last write of a closing output completes the O_DIRECT padding
+// or reused tail is trimmed and the fdatasync queued, ordered after this outputs writes only.
+// when that completes the file is closed and the owner told
+
+static void Uring_CloseSync(Output_t* O)
+{
+	if ((O->IsDirect || O->IsTruncate) && (O->Error == 0) && (ftruncate(O->FD, O->Size) != 0)) O->Error = errno;
+
+	struct io_uring_sqe* SQE = Uring_SQE();
+	SQE->opcode		= IORING_OP_FSYNC;
+	SQE->fd			= O->FD;
+	SQE->fsync_flags= IORING_FSYNC_DATASYNC;
+	SQE->user_data	= URING_TAG_CTRL | (u64)O;
+	O->InFlight++;
+
+	O->IsSyncQueued = true;
+}
+
+static void Uring_CloseFinish(Output_t* O)
+{
+	int Result = 0;
+	if (O->Error != 0)
+	{
+		fprintf(stderr, "io_uring write failed %i %s\n", O->Error, strerror(O->Error));
+		Result = -1;
+	}
+
+	// data is durable, evict whatever is left of the file
+	if (O->IsDropCache) posix_fadvise(O->FD, 0, 0, POSIX_FADV_DONTNEED);
+
+	close(O->FD);
+
+	if (O->Done) O->Done(O->DoneUser, Result);
+	free(O);
+}
+
+// process all available completions
+static void Uring_Reap(void)
+{
+	u32 Head = *s_CQHead;
+	while (Head != __atomic_load_n(s_CQTail, __ATOMIC_ACQUIRE))
+	{
+		struct io_uring_cqe* CQE = &s_CQE[Head & s_CQMask];
+		Head++;
+
+		// fsync / writeback completion
+		if (CQE->user_data & URING_TAG_CTRL)
+		{
+			Output_t* O = (Output_t*)(CQE->user_data & ~URING_TAG_CTRL);
+			O->InFlight--;
+			if (CQE->res < 0) O->Error = -CQE->res;
+
+			if (O->IsClosing && !O->IsSyncQueued && (O->InFlight == 0)) Uring_CloseSync(O);
+			continue;
+		}
+
+		UringBuffer_t* B = &s_Buffer[CQE->user_data];
+		Output_t* O = B->Owner;
+		O->InFlight--;
+
+		if (CQE->res < 0)
+		{
+			O->Error = -CQE->res;
+		}
+		// short write, queue the remainder
+		else if (B->Pos + CQE->res < B->Length)
+		{
+			if (CQE->res == 0)
+			{
+				O->Error = ENOSPC;
+			}
+			else
+			{
+				B->Pos += CQE->res;
+				Uring_QueueWrite(CQE->user_data);
+				continue;
+			}
+		}
+
+		Pool_Free(s_Pool, B->Buffer);
+		B->Buffer	= NULL;
+		B->IsBusy	= false;
+		B->Owner	= NULL;
+
+		if (O->IsClosing && !O->IsSyncQueued && (O->InFlight == 0)) Uring_CloseSync(O);
+	}
+	__atomic_store_n(s_CQHead, Head, __ATOMIC_RELEASE);
+
+	// resubmits / fdatasync`s queued above
+	Uring_Enter(0);
+
+	// finish closes outside the completion loop, the owner callback may do anything
+	Output_t** Prev = &s_CloseList;
+	while (*Prev)
+	{
+		Output_t* O = *Prev;
+		if (O->IsSyncQueued && (O->InFlight == 0))
+		{
+			*Prev = O->CloseNext;
+			Uring_CloseFinish(O);
+			continue;
+		}
+		Prev = &O->CloseNext;
+	}
+}
+
+// find a free buffer, waiting on completions if everything is in flight
+static s32 Uring_BufferAlloc(void)
+{
+	while (true)
+	{
+		for (int i=0; i < s_BufferCnt; i++)
+		{
+			u32 Index = (s_BufferNext + i) % s_BufferCnt;
+			if (!s_Buffer[Index].IsBusy)
+			{
+				s_BufferNext = Index + 1;
+				s_Buffer[Index].IsBusy = true;
+				s_Buffer[Index].Buffer = Pool_Alloc(s_Pool);
+				assert(s_Buffer[Index].Buffer != NULL);
+				return Index;
+			}
+		}
+
+		// all buffers in flight
+		Uring_Enter(1);
+		Uring_Reap();
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// keep the page cache flat. once a full window is queued start async writeback on the
+// previous window, and wait + evict the one before that. both windows are far enough behind
+// the head that their writes have normally completed, so nothing here stalls the main loop
+
+static void Uring_DropCache(Output_t* O)
+{
+	while (O->Offset >= O->DropOffset + 2 * URING_DROP_WINDOW)
+	{
+		// the linked wait + evict pair has to go in the same submit
+		Uring_SQEReserve(3);
+
+		u64 Start = O->DropOffset + URING_DROP_WINDOW;
+
+		struct io_uring_sqe* SQE = Uring_SQE();
+		SQE->opcode				= IORING_OP_SYNC_FILE_RANGE;
+		SQE->fd					= O->FD;
+		SQE->off				= Start;
+		SQE->len				= URING_DROP_WINDOW;
+		SQE->sync_range_flags	= SYNC_FILE_RANGE_WRITE;
+		SQE->user_data			= URING_TAG_CTRL | (u64)O;
+		O->InFlight++;
+
+		if (O->DropOffset >= URING_DROP_WINDOW)
+		{
+			Start = O->DropOffset - URING_DROP_WINDOW;
+
+			SQE = Uring_SQE();
+			SQE->opcode				= IORING_OP_SYNC_FILE_RANGE;
+			SQE->flags				= IOSQE_IO_LINK;
+			SQE->fd					= O->FD;
+			SQE->off				= Start;
+			SQE->len				= URING_DROP_WINDOW;
+			SQE->sync_range_flags	= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+			SQE->user_data			= URING_TAG_CTRL | (u64)O;
+			O->InFlight++;
+
+			SQE = Uring_SQE();
+			SQE->opcode				= IORING_OP_FADVISE;
+			SQE->fd					= O->FD;
+			SQE->off				= Start;
+			SQE->len				= URING_DROP_WINDOW;
+			SQE->fadvise_advice		= POSIX_FADV_DONTNEED;
+			SQE->user_data			= URING_TAG_CTRL | (u64)O;
+			O->InFlight++;
+		}
+
+		O->DropOffset += URING_DROP_WINDOW;
+	}
+}
+
+// queue the buffer currently being filled
+static void Uring_BufferSubmit(Output_t* O)
+{
+	if (O->BufferIndex < 0) return;
+
+	UringBuffer_t* B = &s_Buffer[O->BufferIndex];
+	O->BufferIndex = -1;
+
+	// nothing written into it
+	if (B->Length == 0)
+	{
+		Pool_Free(s_Pool, B->Buffer);
+		B->Buffer	= NULL;
+		B->IsBusy	= false;
+		B->Owner	= NULL;
+		return;
+	}
+
+	// O_DIRECT needs block sized writes, pad the tail. truncated back on close
+	if (O->IsDirect && (B->Length % URING_DIRECT_ALIGN))
+	{
+		u32 Pad = URING_DIRECT_ALIGN - (B->Length % URING_DIRECT_ALIGN);
+		memset(B->Buffer + B->Length, 0, Pad);
+		B->Length += Pad;
+	}
+
+	Uring_QueueWrite(B - s_Buffer);
+	O->Offset += B->Length;
+
+	if (O->IsDropCache) Uring_DropCache(O);
+
+	Uring_Enter(0);
+	Uring_Reap();
+}
+
+//---------------------------------------------------------------------------------------------
+
+int Output_Init(u32 Engine, u32 Flags, struct Pool_t* Pool)
+{
+	s_Engine	= Engine;
+	s_Flags		= Flags;
+	if (Engine != OUTPUT_ENGINE_URING) return 0;
+
+	u32 QueueDepth	= 0;
+	Pool_Stats(Pool, NULL, NULL, &QueueDepth);
+
+	if (Uring_Setup(QueueDepth, Pool_BufferSize(Pool)) < 0)
+	{
+		fprintf(stderr, "io_uring unavailable, falling back to pipe output\n");
+		s_Engine = OUTPUT_ENGINE_PIPE;
+		return -1;
+	}
+
+	s_Pool			= Pool;
+	s_BufferCnt		= QueueDepth;
+	s_BufferSize	= Pool_BufferSize(Pool);
+	s_Buffer		= calloc(s_BufferCnt, sizeof(UringBuffer_t));
+	assert(s_Buffer != NULL);
+
+	fprintf(stderr, "io_uring output: Depth %i Buffer %i KB Ring %i%s%s\n", s_BufferCnt, s_BufferSize / 1024, s_UringEntries,
+																			(s_Flags & OUTPUT_FLAG_DIRECT) 		? " O_DIRECT" : "",
+																			(s_Flags & OUTPUT_FLAG_DROPCACHE) 	? " DropCache" : "");
+	return 0;
+}
+
+u32 Output_Engine(void)
+{
+	return s_Engine;
+}
+
+//---------------------------------------------------------------------------------------------
+// pipe engine uses the full command, uring writes directly to FileName
+
+Output_t* Output_Open(u8* Cmd, u8* FileName, u32 OpenFlags)
+{
+	Output_t* O = calloc(1, sizeof(Output_t));
+	assert(O != NULL);
+
+	O->Engine		= s_Engine;
+	O->FD			= -1;
+	O->BufferIndex	= -1;
+
+	switch (O->Engine)
+	{
+	case OUTPUT_ENGINE_PIPE:
+		O->Pipe = popen(Cmd, "w");
+		if (!O->Pipe)
+		{
+			free(O);
+			return NULL;
+		}
+		break;
+
+	case OUTPUT_ENGINE_URING:
+		// overwrite a reused file in place so its blocks stay allocated
+		O->IsTruncate = (OpenFlags & OUTPUT_OPEN_REUSE) != 0;
+		int Trunc = (OpenFlags & (OUTPUT_OPEN_REUSE | OUTPUT_OPEN_APPEND)) ? 0 : O_TRUNC;
+
+		// appending continues from an unaligned tail, so no O_DIRECT
+		if ((s_Flags & OUTPUT_FLAG_DIRECT) && !(OpenFlags & OUTPUT_OPEN_APPEND))
+		{
+			O->FD = open(FileName, O_CREAT | Trunc | O_WRONLY | O_DIRECT, 0666);
+			O->IsDirect = (O->FD >= 0);
+
+			// filesystem does not support O_DIRECT (e.g tmpfs) fall back to evicting behind the head
+			if ((O->FD < 0) && (errno == EINVAL))
+			{
+				static bool IsWarned = false;
+				if (!IsWarned) fprintf(stderr, "O_DIRECT not supported for [%s] using page cache eviction\n", FileName);
+				IsWarned = true;
+
+				O->IsDropCache = true;
+			}
+		}
+		if ((s_Flags & OUTPUT_FLAG_DROPCACHE) || ((s_Flags & OUTPUT_FLAG_DIRECT) && (OpenFlags & OUTPUT_OPEN_APPEND)))
+		{
+			O->IsDropCache = true;
+		}
+		if (!O->IsDirect)
+		{
+			O->FD = open(FileName, O_CREAT | Trunc | O_WRONLY, 0666);
+		}
+		if (O->FD < 0)
+		{
+			free(O);
+			return NULL;
+		}
+
+		// continue writing after the existing data
+		if (OpenFlags & OUTPUT_OPEN_APPEND)
+		{
+			struct stat st;
+			fstat(O->FD, &st);
+
+			O->Offset		= st.st_size;
+			O->Size			= st.st_size;
+			O->DropOffset	= st.st_size & ~(URING_DROP_WINDOW - 1);
+		}
+		break;
+	}
+	return O;
+}
+
+//---------------------------------------------------------------------------------------------
+// returns bytes written or -1 on failure
+
+int Output_Write(Output_t* O, void* Buf, u32 Length)
+{
+	if (O->Engine == OUTPUT_ENGINE_PIPE)
+	{
+		// fwrite only blocks when the stdio buffer drains into a full pipe, but that cant be
+		// seen from here so every write is timed when asked for
+		u64 TSC = (s_Flags & OUTPUT_FLAG_BLOCKSTAT) ? rdtsc() : 0;
+		int wlen = fwrite(Buf, 1, Length, O->Pipe);
+		if (TSC != 0) s_BlockTSC += rdtsc() - TSC;
+
+		return (wlen == Length) ? wlen : -1;
+	}
+
+	// failure from a previous completion
+	if (O->Error != 0)
+	{
+		errno = O->Error;
+		return -1;
+	}
+
+	u8* Data = (u8*)Buf;
+	u32 Remain = Length;
+	while (Remain > 0)
+	{
+		if (O->BufferIndex < 0)
+		{
+			O->BufferIndex = Uring_BufferAlloc();
+
+			UringBuffer_t* B = &s_Buffer[O->BufferIndex];
+			B->Owner	= O;
+			B->Offset	= O->Offset;
+			B->Length	= 0;
+			B->Pos		= 0;
+		}
+
+		UringBuffer_t* B = &s_Buffer[O->BufferIndex];
+
+		u32 Copy = min32(Remain, s_BufferSize - B->Length);
+		memcpy(B->Buffer + B->Length, Data, Copy);
+		B->Length	+= Copy;
+		Data		+= Copy;
+		Remain		-= Copy;
+
+		if (B->Length == s_BufferSize) Uring_BufferSubmit(O);
+	}
+	O->Size += Length;
+
+	return Length;
+}
+
+//---------------------------------------------------------------------------------------------
+// uring output is pushed as buffers fill, only the pipe needs an explicit flush
+
+int Output_Flush(Output_t* O)
+{
+	if (O->Engine != OUTPUT_ENGINE_PIPE) return 0;
+
+	u64 TSC = rdtsc();
+	int Result = fflush(O->Pipe);
+	s_BlockTSC += rdtsc() - TSC;
+
+	return Result;
+}
+
+//---------------------------------------------------------------------------------------------
+// pipe closes in line. uring queues the tail and returns, the trim / fdatasync / close run
+// from later completions and Done is called once the file is complete
+
+int Output_Close(Output_t* O, Output_Done_f* Done, void* User)
+{
+	if (O->Engine == OUTPUT_ENGINE_PIPE)
+	{
+		int Result = pclose(O->Pipe);
+		free(O);
+
+		if (Done) Done(User, Result);
+		return Result;
+	}
+
+	O->IsClosing	= true;
+	O->Done			= Done;
+	O->DoneUser		= User;
+	O->CloseNext	= s_CloseList;
+	O->CloseSeq		= s_CloseSeq++;
+	s_CloseList		= O;
+
+	Uring_BufferSubmit(O);
+
+	// nothing in flight, no completion to start the sync from
+	if (!O->IsSyncQueued && (O->InFlight == 0))
+	{
+		Uring_CloseSync(O);
+		Uring_Enter(0);
+	}
+	return 0;
+}
+
+// pick up background closes while no writes are being queued
+void Output_Poll(void)
+{
+	if (s_Engine != OUTPUT_ENGINE_URING) return;
+
+	Uring_Reap();
+}
+
+// number of closes started so far, a marker for Output_IsClosing
+u64 Output_CloseSeq(void)
+{
+	return s_CloseSeq;
+}
+
+// any close started before the Seq marker still finishing in the background
+bool Output_IsClosing(u64 Seq)
+{
+	for (Output_t* O = s_CloseList; O != NULL; O = O->CloseNext)
+	{
+		if (O->CloseSeq < Seq) return true;
+	}
+	return false;
+}
+
+// wait for every background close to finish
+void Output_Drain(void)
+{
+	if (s_Engine != OUTPUT_ENGINE_URING) return;
+
+	Uring_Reap();
+	while (s_CloseList)
+	{
+		Uring_Enter(1);
+		Uring_Reap();
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+
+u64 Output_BlockTSC(void)
+{
+	return s_BlockTSC;
+}
@@ -0,0 +1,48 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// split output writers. popen pipe or io_uring direct to disk
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#define OUTPUT_ENGINE_PIPE				0					// popen(cmd) + fwrite
+#define OUTPUT_ENGINE_URING				1					// io_uring queued writes direct to the file
+
+#define OUTPUT_FLAG_DIRECT				(1<<0)				// open with O_DIRECT, pad only the final tail
+#define OUTPUT_FLAG_DROPCACHE			(1<<1)				// sync_file_range + fadvise(DONTNEED) behind the write head
+#define OUTPUT_FLAG_BLOCKSTAT			(1<<2)				// time every pipe write, uring waits are always timed
+
+#define OUTPUT_OPEN_REUSE				(1<<0)				// overwrite an existing file in place, trim the old tail at close
+#define OUTPUT_OPEN_APPEND				(1<<1)				// continue after the existing data. pipe Cmd must append itself
+
+struct Output_t;
+struct Pool_t;
+
+// close completion, Result is 0 or -1 on a write / sync failure
+typedef void Output_Done_f(void* User, int Result);
+
+// engine setup, call once before any Output_Open. queue depth / buffer size come from the pool
+int					Output_Init			(u32 Engine, u32 Flags, struct Pool_t* Pool);
+u32					Output_Engine		(void);
+
+struct Output_t*	Output_Open			(u8* Cmd, u8* FileName, u32 OpenFlags);
+int					Output_Write		(struct Output_t* O, void* Buf, u32 Length);
+int					Output_Flush		(struct Output_t* O);
+
+// Done runs once the file is complete, in line for the pipe engine. the uring engine
+// finishes the close in the background, from a later Output_Write / Output_Poll
+int					Output_Close		(struct Output_t* O, Output_Done_f* Done, void* User);
+
+void				Output_Poll			(void);
+u64					Output_CloseSeq		(void);
+bool				Output_IsClosing	(u64 Seq);
+void				Output_Drain		(void);
+
+// total TSC cycles the caller spent blocked on output
+u64					Output_BlockTSC		(void);
+
+#endif
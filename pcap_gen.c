@@ -0,0 +1,257 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// deterministic synthetic traffic generator for benchmarking pcap_split
+//
+// writes a pcap (nsec or usec) or FMAD chunked stream to stdout. packet sizes come from a
+// fixed size, a uniform range or the simple IMIX mix, timestamps advance at a fixed packet
+// rate. the same arguments always produce the same bytes
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "fTypes.h"
+#include "pcapfile.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define FORMAT_PCAP_NSEC				0
+#define FORMAT_PCAP_USEC				1
+#define FORMAT_FMAD						2
+
+#define SIZE_FIXED						0
+#define SIZE_RANGE						1
+#define SIZE_IMIX						2
+
+#define FMAD_CHUNK_MAX					kKB(256)			// payload bytes per FMAD chunk
+
+static u32		s_Format					= FORMAT_PCAP_NSEC;
+static u64		s_PktMax					= 10e6;
+static u32		s_SizeMode					= SIZE_IMIX;
+static u32		s_SizeMin					= 64;
+static u32		s_SizeMax					= 1514;
+static double	s_Rate						= 10e6;		// packets per second of capture time
+static u64		s_StartSec					= 1650000000;
+static u64		s_Seed						= 1;
+
+//---------------------------------------------------------------------------------------------
+
+static INLINE u64 Random(void)
+{
+	// xorshift64*
+	s_Seed ^= s_Seed >> 12;
+	s_Seed ^= s_Seed << 25;
+	s_Seed ^= s_Seed >> 27;
+	return s_Seed * 2685821657736338717ULL;
+}
+
+static u32 PacketSize(void)
+{
+	switch (s_SizeMode)
+	{
+	case SIZE_FIXED:
+		return s_SizeMin;
+
+	case SIZE_RANGE:
+		return s_SizeMin + Random() % (s_SizeMax - s_SizeMin + 1);
+
+	case SIZE_IMIX:
+	default:
+		{
+			// 7:4:1 of 64, 576, 1500 byte frames
+			u32 Slot = Random() % 12;
+			if (Slot < 7)	return 64;
+			if (Slot < 11)	return 576;
+			return 1500;
+		}
+	}
+}
+
+// ethernet/ipv4/udp looking frame with the sequence number in the payload
+static void PacketFill(u8* Payload, u32 Length, u64 Seq)
+{
+	memset(Payload, 0, Length);
+
+	static const u8 Eth[14] = { 0x00,0x11,0x22,0x33,0x44,0x55, 0x00,0x66,0x77,0x88,0x99,0xaa, 0x08,0x00 };
+	memcpy(Payload, Eth, sizeof(Eth));
+
+	u8* IP = Payload + 14;
+	IP[0] = 0x45;
+	IP[9] = 17;
+	IP[12] = 10; IP[13] = 0; IP[14] = (Seq >> 8) & 0xff; IP[15] = Seq & 0xff;
+	IP[16] = 10; IP[17] = 1; IP[18] = 0; IP[19] = 1;
+
+	if (Length >= 14 + 20 + 8 + 8) memcpy(Payload + 14 + 20 + 8, &Seq, sizeof(Seq));
+}
+
+//---------------------------------------------------------------------------------------------
+
+static void Help(void)
+{
+	printf("pcap_gen [options] > out.pcap\n");
+	printf("\n");
+	printf("--format <pcap-nsec|pcap-usec|fmad> : output format (default pcap-nsec)\n");
+	printf("--pkts <count>                      : number of packets (default 10e6)\n");
+	printf("--size <imix|n|min-max>             : packet size mix, fixed or uniform range (default imix)\n");
+	printf("--rate <pps>                        : capture timestamp rate in packets per second (default 10e6)\n");
+	printf("--start <epoch sec>                 : timestamp of the first packet\n");
+	printf("--seed <n>                          : random seed for the size mix\n");
+	printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i=1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0)
+		{
+			if		(strcmp(argv[i+1], "pcap-nsec") == 0)	s_Format = FORMAT_PCAP_NSEC;
+			else if (strcmp(argv[i+1], "pcap-usec") == 0)	s_Format = FORMAT_PCAP_USEC;
+			else if (strcmp(argv[i+1], "fmad") == 0)		s_Format = FORMAT_FMAD;
+			else
+			{
+				fprintf(stderr, "unknown format [%s]\n", argv[i+1]);
+				return 1;
+			}
+			i++;
+		}
+		else if (strcmp(argv[i], "--pkts") == 0)
+		{
+			s_PktMax = atof(argv[i+1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "--size") == 0)
+		{
+			if (strcmp(argv[i+1], "imix") == 0)
+			{
+				s_SizeMode = SIZE_IMIX;
+			}
+			else if (sscanf(argv[i+1], "%u-%u", &s_SizeMin, &s_SizeMax) == 2)
+			{
+				s_SizeMode = SIZE_RANGE;
+			}
+			else
+			{
+				s_SizeMode = SIZE_FIXED;
+				s_SizeMin  = atoi(argv[i+1]);
+			}
+			i++;
+		}
+		else if (strcmp(argv[i], "--rate") == 0)
+		{
+			s_Rate = atof(argv[i+1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "--start") == 0)
+		{
+			s_StartSec = atof(argv[i+1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			s_Seed = atoll(argv[i+1]);
+			i++;
+		}
+		else
+		{
+			Help();
+			return 1;
+		}
+	}
+	if ((s_SizeMin < 60) || (s_SizeMax > 9216) || (s_SizeMin > s_SizeMax) || (s_Rate <= 0) || (s_Seed == 0))
+	{
+		fprintf(stderr, "invalid config. sizes 60-9216 bytes, rate > 0, seed != 0\n");
+		return 1;
+	}
+
+	// large stdout buffer, output is normally a pipe
+	setvbuf(stdout, NULL, _IOFBF, kMB(1));
+
+	PCAPHeader_t Header;
+	memset(&Header, 0, sizeof(Header));
+	Header.Magic	= (s_Format == FORMAT_PCAP_USEC) ? PCAPHEADER_MAGIC_USEC :
+					  (s_Format == FORMAT_FMAD)		 ? PCAPHEADER_MAGIC_FMAD : PCAPHEADER_MAGIC_NANO;
+	Header.Major	= PCAPHEADER_MAJOR;
+	Header.Minor	= PCAPHEADER_MINOR;
+	Header.SnapLen	= 0xffff;
+	Header.Link		= PCAPHEADER_LINK_ETHERNET;
+	fwrite(&Header, 1, sizeof(Header), stdout);
+
+	u8* Chunk		= malloc(FMAD_CHUNK_MAX + sizeof(FMADPacket_t) + 9216);
+	u8* Payload		= malloc(9216);
+	assert((Chunk != NULL) && (Payload != NULL));
+
+	FMADHeader_t ChunkHeader;
+	memset(&ChunkHeader, 0, sizeof(ChunkHeader));
+
+	u64 TS			= s_StartSec * k1E9;
+	double TSFrac	= 0;
+	double TSStep	= 1e9 / s_Rate;
+	u64 TotalByte	= 0;
+
+	for (u64 Seq=0; Seq < s_PktMax; Seq++)
+	{
+		u32 Length = PacketSize();
+		PacketFill(Payload, Length, Seq);
+
+		switch (s_Format)
+		{
+		case FORMAT_PCAP_NSEC:
+		case FORMAT_PCAP_USEC:
+		{
+			PCAPPacket_t Pkt;
+			Pkt.Sec				= TS / k1E9;
+			Pkt.NSec			= TS % k1E9;
+			if (s_Format == FORMAT_PCAP_USEC) Pkt.NSec /= 1000;
+			Pkt.LengthCapture	= Length;
+			Pkt.LengthWire		= Length;
+
+			fwrite(&Pkt, 1, sizeof(Pkt), stdout);
+			fwrite(Payload, 1, Length, stdout);
+		}
+		break;
+
+		case FORMAT_FMAD:
+		{
+			FMADPacket_t* Pkt	= (FMADPacket_t*)(Chunk + ChunkHeader.Length);
+			memset(Pkt, 0, sizeof(FMADPacket_t));
+			Pkt->TS				= TS;
+			Pkt->LengthCapture	= Length;
+			Pkt->LengthWire		= Length;
+			memcpy(Pkt + 1, Payload, Length);
+
+			if (ChunkHeader.PktCnt == 0) ChunkHeader.TSStart = TS;
+			ChunkHeader.TSEnd			 = TS;
+			ChunkHeader.PktCnt			+= 1;
+			ChunkHeader.BytesWire		+= Length;
+			ChunkHeader.BytesCapture	+= Length;
+			ChunkHeader.Length			+= sizeof(FMADPacket_t) + Length;
+
+			// flush full chunks and the final partial chunk
+			if ((ChunkHeader.Length >= FMAD_CHUNK_MAX) || (Seq + 1 == s_PktMax))
+			{
+				fwrite(&ChunkHeader, 1, sizeof(ChunkHeader), stdout);
+				fwrite(Chunk, 1, ChunkHeader.Length, stdout);
+				memset(&ChunkHeader, 0, sizeof(ChunkHeader));
+			}
+		}
+		break;
+		}
+		TotalByte += Length;
+
+		// fixed packet rate
+		TSFrac	+= TSStep;
+		TS		+= (u64)TSFrac;
+		TSFrac	-= (u64)TSFrac;
+	}
+	fflush(stdout);
+
+	fprintf(stderr, "pcap_gen: %lli packets %lli bytes %.3f sec of capture\n", s_PktMax, TotalByte, (TS - s_StartSec * k1E9) / 1e9);
+	return 0;
+}
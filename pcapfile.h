@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// on disk pcap / FMAD chunked layouts, shared by pcap_split and pcap_gen
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __PCAPFILE_H__
+#define __PCAPFILE_H__
+
+// defined in fmadio_packet.h  
+#ifndef  __FMADIO_PACKET_H__
+
+#define PCAPHEADER_MAGIC_NANO		0xa1b23c4d
+#define PCAPHEADER_MAGIC_USEC		0xa1b2c3d4
+#define PCAPHEADER_MAGIC_FMAD		0x1337bab3
+
+#define PCAPHEADER_MAJOR			2
+#define PCAPHEADER_MINOR			4
+#define PCAPHEADER_LINK_ETHERNET	1
+#define PCAPHEADER_LINK_ERF			197	
+
+typedef struct
+{
+	u32				Sec;				// time stamp sec since epoch 
+	u32				NSec;				// nsec fraction since epoch
+
+	u32				LengthCapture;		// captured length, inc trailing / aligned data
+	u32				LengthWire;			// length on the wire
+
+} __attribute__((packed)) PCAPPacket_t;
+
+// per file header
+
+typedef struct
+{
+	u32				Magic;
+	u16				Major;
+	u16				Minor;
+	u32				TimeZone;
+	u32				SigFlag;
+	u32				SnapLen;
+	u32				Link;
+
+} __attribute__((packed)) PCAPHeader_t;
+
+#endif
+
+
+// packet header
+typedef struct FMADPacket_t
+{
+	u64             TS;                     // 64bit nanosecond epoch
+
+	u32             LengthCapture   : 16;   // length captured
+	u32             LengthWire      : 16;   // Length on the wire
+
+	u32             PortNo          :  8;   // Port number
+	u32             Flag            :  8;   // flags
+	u32             pad0            : 16;
+
+} __attribute__((packed)) FMADPacket_t;
+
+#define FMAD_PACKET_FLAG_FCS		(1<<0)		// flags invalid FCS was captured 
+
+// header per packet
+typedef struct FMADHeader_t
+{
+	u16				PktCnt;					// number of packets
+	u16				CRC16;
+
+	u32				BytesWire;				// total wire bytes  
+	u32				BytesCapture;			// total capture bytes 
+	u32				Length;					// length of this block in bytes
+
+	u64				TSStart;				// TS of first packet
+	u64				TSEnd;					// TS of last packet 
+
+	// internal performance stats passed downstream
+	u64				BytePending;			// how many bytes pending 
+	u16				CPUActive;				// cpu pct stream_cat is active  
+	u16				CPUFetch;	
+	u16				CPUSend;	
+	u16				pad1;			
+
+} __attribute__((packed)) FMADHeader_t;
+
+#endif
@@ -0,0 +1,101 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// libpcapsplit, the splitter as an in process library
+//
+// the caller owns the input and pushes batches of nanosecond pcap records, the splitter
+// writes them out exactly as pcap_split would. options are the pcap_split command line,
+// minus the input options (--ring etc). splitter state is process wide and is not reset
+// on close, so PCAPSplit_Open succeeds once per process
+//
+// self contained so it can be included without fTypes.h
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __PCAPSPLIT_H__
+#define __PCAPSPLIT_H__
+
+#include <stdint.h>
+
+// nanosecond pcap record header, payload follows directly. same layout as a pcap file
+// record. the splitter writes header + payload in one go and may rewrite the lengths
+// (--packet-chomp, dropped packets). LengthWire == 0 is an idle keep alive, nothing is
+// written but time splits still advance
+typedef struct PCAPSplitPacket_t
+{
+	uint32_t			Sec;								// time stamp sec since epoch
+	uint32_t			NSec;								// nsec fraction since epoch
+
+	uint32_t			LengthCapture;						// captured length
+	uint32_t			LengthWire;							// length on the wire
+
+} __attribute__((packed)) PCAPSplitPacket_t;
+
+typedef struct PCAPSplitStats_t
+{
+	uint64_t			TotalByte;							// bytes written, inc record headers
+	uint64_t			TotalPkt;							// packets written
+	uint64_t			DropPkt;							// packets not written to any split
+	uint32_t			TotalSplit;							// splits opened
+	uint64_t			LastTS;								// last pushed timestamp, inc keep alives
+	const char*			FileName;							// current split
+
+} PCAPSplitStats_t;
+
+typedef struct PCAPSplit_t PCAPSplit_t;
+
+// argv[0] is ignored. NULL on a bad config or if called before, even after PCAPSplit_Close
+PCAPSplit_t*		PCAPSplit_Open		(int argc, char* argv[]);
+
+// split a batch of records, returns the number consumed. less than PktCnt is a fatal
+// output error and the splitter should be closed
+uint32_t			PCAPSplit_Push		(PCAPSplit_t* S, PCAPSplitPacket_t* Pkt[], uint32_t PktCnt);
+
+// periodic status / retention / checkpoint work, rate limited to about once a second so
+// it can be called every batch. Stats is optional
+void				PCAPSplit_Poll		(PCAPSplit_t* S, PCAPSplitStats_t* Stats);
+
+// flush, close the last split and wait for compression / uploads
+void				PCAPSplit_Close		(PCAPSplit_t* S);
+
+//---------------------------------------------------------------------------------------------
+// plugins, --plugin <file.so>
+//
+// the shared object exports PCAPSplit_Plugin() returning its hook table with Version set to
+// PCAPSPLIT_PLUGIN_VERSION. any hook can be NULL. hooks run on the splitter thread in line
+// with the packets so must not block
+
+#define PCAPSPLIT_PLUGIN_VERSION		1
+#define PCAPSPLIT_PLUGIN_ENTRY			"PCAPSplit_Plugin"
+
+#define PCAPSPLIT_ROUTE_WRITE			0					// write to the current split
+#define PCAPSPLIT_ROUTE_DROP			1					// not written, counted as dropped
+#define PCAPSPLIT_ROUTE_ROLL			2					// close the current split and start a new one with this packet
+
+typedef struct PCAPSplitPlugin_t
+{
+	uint32_t			Version;
+	const char*			Name;
+
+	// Arg is --plugin-arg or NULL, the return value is passed back to every hook
+	void*				(*Open)			(const char* Arg);
+	void				(*Close)		(void* User);
+
+	// a batch of records in arrival order, Route[] is preset to WRITE. keep alives
+	// (LengthWire 0) are included and their route ignored. records can be rewritten in
+	// place as long as LengthCapture does not grow
+	void				(*Route)		(void* User, PCAPSplitPacket_t* Pkt[], uint8_t Route[], uint32_t PktCnt);
+
+	// split started at TS / closed, called before the .pending file is renamed to FileName
+	void				(*SplitOpen)	(void* User, const char* FileName, uint64_t TS);
+	void				(*SplitClose)	(void* User, const char* FileName, uint64_t Byte, uint64_t Pkt);
+
+	// about once a second, and once more on close
+	void				(*Stats)		(void* User, const PCAPSplitStats_t* Stats);
+
+} PCAPSplitPlugin_t;
+
+typedef PCAPSplitPlugin_t* PCAPSplitPluginEntry_f(void);
+
+#endif
@@ -0,0 +1,92 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// in process plugins
+//
+// --plugin loads a shared object with dlopen and keeps its hook table. hooks are called
+// directly from the splitter, routing a batch of packets at a time, so custom sharding or
+// tagging runs without a process per split like --script-new / --script-close
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "fTypes.h"
+#include "pcapsplit.h"
+#include "plugin.h"
+
+//---------------------------------------------------------------------------------------------
+
+static void*				s_Handle		= NULL;
+static PCAPSplitPlugin_t*	s_Plugin		= NULL;
+static void*				s_User			= NULL;
+
+//---------------------------------------------------------------------------------------------
+
+bool Plugin_Open(u8* FileName, u8* Arg)
+{
+	s_Handle = dlopen(FileName, RTLD_NOW | RTLD_LOCAL);
+	if (!s_Handle)
+	{
+		fprintf(stderr, "plugin [%s] load failed: %s\n", FileName, dlerror());
+		return false;
+	}
+
+	PCAPSplitPluginEntry_f* Entry = (PCAPSplitPluginEntry_f*)dlsym(s_Handle, PCAPSPLIT_PLUGIN_ENTRY);
+	if (!Entry)
+	{
+		fprintf(stderr, "plugin [%s] has no %s()\n", FileName, PCAPSPLIT_PLUGIN_ENTRY);
+		return false;
+	}
+
+	s_Plugin = Entry();
+	if (!s_Plugin || (s_Plugin->Version != PCAPSPLIT_PLUGIN_VERSION))
+	{
+		fprintf(stderr, "plugin [%s] version %i expected %i\n", FileName, s_Plugin ? s_Plugin->Version : 0, PCAPSPLIT_PLUGIN_VERSION);
+		s_Plugin = NULL;
+		return false;
+	}
+
+	if (s_Plugin->Open) s_User = s_Plugin->Open(Arg);
+
+	fprintf(stderr, "plugin [%s] %s\n", FileName, s_Plugin->Name ? s_Plugin->Name : "");
+	return true;
+}
+
+void Plugin_Close(void)
+{
+	if (!s_Plugin) return;
+
+	if (s_Plugin->Close) s_Plugin->Close(s_User);
+	s_Plugin = NULL;
+
+	// the plugin may have threads of its own, leave it mapped until exit
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Plugin_Route(PCAPSplitPacket_t* Pkt[], u8 Route[], u32 PktCnt)
+{
+	memset(Route, PCAPSPLIT_ROUTE_WRITE, PktCnt);
+	if (s_Plugin->Route) s_Plugin->Route(s_User, Pkt, Route, PktCnt);
+}
+
+void Plugin_SplitOpen(u8* FileName, u64 TS)
+{
+	if (s_Plugin->SplitOpen) s_Plugin->SplitOpen(s_User, FileName, TS);
+}
+
+void Plugin_SplitClose(u8* FileName, u64 Byte, u64 Pkt)
+{
+	if (s_Plugin->SplitClose) s_Plugin->SplitClose(s_User, FileName, Byte, Pkt);
+}
+
+void Plugin_Stats(PCAPSplitStats_t* Stats)
+{
+	if (s_Plugin->Stats) s_Plugin->Stats(s_User, Stats);
+}
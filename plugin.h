@@ -0,0 +1,23 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// in process plugins, the hook ABI is in pcapsplit.h
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __PLUGIN_H__
+#define __PLUGIN_H__
+
+// load the shared object and call its Open hook
+bool				Plugin_Open			(u8* FileName, u8* Arg);
+void				Plugin_Close		(void);
+
+// Route[] comes back with a PCAPSPLIT_ROUTE_* per packet
+void				Plugin_Route		(PCAPSplitPacket_t* Pkt[], u8 Route[], u32 PktCnt);
+
+void				Plugin_SplitOpen	(u8* FileName, u64 TS);
+void				Plugin_SplitClose	(u8* FileName, u64 Byte, u64 Pkt);
+void				Plugin_Stats		(PCAPSplitStats_t* Stats);
+
+#endif
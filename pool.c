@@ -0,0 +1,182 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// fixed size buffer pool
+//
+// one contiguous region carved into equal buffers. the region is backed by 2MB hugepages
+// (MAP_HUGETLB, falling back to transparent hugepages) and bound to the numa node of the
+// cpus the process runs on before it is faulted in. buffers are recycled through a lock
+// free index stack so the hot path never touches malloc/free, and it is safe for a
+// reader and writer thread to alloc/free concurrently
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "fTypes.h"
+#include "pool.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define POOL_HUGEPAGE					kMB(2)
+#define POOL_INDEX_NULL					0xffffffff
+
+typedef struct Pool_t
+{
+	u8					Name[64];
+
+	u8*					Base;								// start of the mapped region
+	u64					MapSize;							// mapped size, hugepage rounded
+	u64					BufferSize;
+	u32					BufferCnt;
+
+	u32*				Next;								// free stack links
+	volatile u64		Head;								// tag:32 | index:32 of top of the free stack
+
+	volatile u32		Used;								// buffers currently allocated
+	volatile u32		HighWater;							// max buffers allocated
+
+	bool				IsHugeTLB;							// explicit hugetlb pages
+
+} Pool_t;
+
+//---------------------------------------------------------------------------------------------
+// find the numa node for a cpu via sysfs, -1 if unknown
+
+s32 Pool_CPUNode(u32 CPU)
+{
+	u8 Path[256];
+	sprintf(Path, "/sys/devices/system/cpu/cpu%i", CPU);
+
+	DIR* D = opendir(Path);
+	if (!D) return -1;
+
+	s32 Node = -1;
+	struct dirent* E;
+	while ((E = readdir(D)) != NULL)
+	{
+		if (strncmp(E->d_name, "node", 4) != 0) continue;
+		if ((E->d_name[4] < '0') || (E->d_name[4] > '9')) continue;
+
+		Node = atoi(E->d_name + 4);
+		break;
+	}
+	closedir(D);
+
+	return Node;
+}
+
+//---------------------------------------------------------------------------------------------
+
+Pool_t* Pool_Create(u8* Name, u64 BufferSize, u32 BufferCnt, s32 NUMANode)
+{
+	Pool_t* P = calloc(1, sizeof(Pool_t));
+	assert(P != NULL);
+
+	strncpy(P->Name, Name, sizeof(P->Name) - 1);
+	P->BufferSize	= BufferSize;
+	P->BufferCnt	= BufferCnt;
+	P->MapSize		= (BufferSize * BufferCnt + POOL_HUGEPAGE - 1) & ~(POOL_HUGEPAGE - 1);
+
+	// explicit 2MB hugepages first, then regular pages with THP advice
+	P->Base = mmap(NULL, P->MapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	P->IsHugeTLB = (P->Base != MAP_FAILED);
+	if (!P->IsHugeTLB)
+	{
+		P->Base = mmap(NULL, P->MapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (P->Base == MAP_FAILED)
+		{
+			fprintf(stderr, "Pool [%s] failed to map %lli bytes %i %s\n", P->Name, P->MapSize, errno, strerror(errno));
+			free(P);
+			return NULL;
+		}
+		madvise(P->Base, P->MapSize, MADV_HUGEPAGE);
+	}
+
+	// bind to the node before faulting anything in
+	if (NUMANode >= 0)
+	{
+		u64 NodeMask = 1ULL << NUMANode;
+		if (syscall(__NR_mbind, P->Base, P->MapSize, MPOL_PREFERRED, &NodeMask, 64, 0) != 0)
+		{
+			fprintf(stderr, "Pool [%s] mbind node %i failed %i %s\n", P->Name, NUMANode, errno, strerror(errno));
+		}
+	}
+	memset(P->Base, 0, P->MapSize);
+
+	// everything starts on the free stack
+	P->Next = malloc(BufferCnt * sizeof(u32));
+	assert(P->Next != NULL);
+	for (int i=0; i < BufferCnt; i++)
+	{
+		P->Next[i] = (i + 1 < BufferCnt) ? i + 1 : POOL_INDEX_NULL;
+	}
+	P->Head = (BufferCnt > 0) ? 0 : POOL_INDEX_NULL;
+
+	fprintf(stderr, "Pool [%s] %i x %lli KB = %.2f MB %s Node %i\n", P->Name, BufferCnt, BufferSize / 1024, P->MapSize / (double)kMB(1),
+																			P->IsHugeTLB ? "HugeTLB" : "THP", NUMANode);
+	return P;
+}
+
+//---------------------------------------------------------------------------------------------
+// returns NULL when the pool is exhausted
+
+void* Pool_Alloc(Pool_t* P)
+{
+	u64 Head = __atomic_load_n(&P->Head, __ATOMIC_ACQUIRE);
+	while (true)
+	{
+		u32 Index = (u32)Head;
+		if (Index == POOL_INDEX_NULL) return NULL;
+
+		// bump the tag so a concurrent pop/push of the same index is detected
+		u64 NewHead = ((Head + (1ULL<<32)) & 0xffffffff00000000ULL) | P->Next[Index];
+		if (__atomic_compare_exchange_n(&P->Head, &Head, NewHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			u32 Used = __atomic_add_fetch(&P->Used, 1, __ATOMIC_RELAXED);
+			if (Used > P->HighWater) P->HighWater = Used;
+
+			return P->Base + Index * P->BufferSize;
+		}
+	}
+}
+
+void Pool_Free(Pool_t* P, void* Buffer)
+{
+	u32 Index = ((u8*)Buffer - P->Base) / P->BufferSize;
+	assert(Index < P->BufferCnt);
+
+	u64 Head = __atomic_load_n(&P->Head, __ATOMIC_ACQUIRE);
+	while (true)
+	{
+		P->Next[Index] = (u32)Head;
+
+		u64 NewHead = ((Head + (1ULL<<32)) & 0xffffffff00000000ULL) | Index;
+		if (__atomic_compare_exchange_n(&P->Head, &Head, NewHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+	}
+	__atomic_sub_fetch(&P->Used, 1, __ATOMIC_RELAXED);
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Pool_Stats(Pool_t* P, u32* pUsed, u32* pHighWater, u32* pTotal)
+{
+	if (pUsed)		pUsed[0]		= P->Used;
+	if (pHighWater)	pHighWater[0]	= P->HighWater;
+	if (pTotal)		pTotal[0]		= P->BufferCnt;
+}
+
+u64 Pool_BufferSize(Pool_t* P)
+{
+	return P->BufferSize;
+}
@@ -0,0 +1,23 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// fixed size buffer pool, hugepage backed and numa local
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+struct Pool_t;
+
+struct Pool_t*	Pool_Create			(u8* Name, u64 BufferSize, u32 BufferCnt, s32 NUMANode);
+void*			Pool_Alloc			(struct Pool_t* P);
+void			Pool_Free			(struct Pool_t* P, void* Buffer);
+
+void			Pool_Stats			(struct Pool_t* P, u32* pUsed, u32* pHighWater, u32* pTotal);
+u64				Pool_BufferSize		(struct Pool_t* P);
+
+s32				Pool_CPUNode		(u32 CPU);
+
+#endif
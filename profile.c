@@ -0,0 +1,166 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// per stage cycle counters and latency histograms
+//
+// stages are timed with rdtsc and converted using the CycleCalibration() result, only when
+// --profile is given so the default hot path pays a single predictable branch. roll and
+// hook time are measured inclusive by the caller, the exclusive split of time is worked out
+// here: split = split decision total - write - roll, roll = roll total - hook.
+//
+// histograms are log2 buckets of nanoseconds
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "fTypes.h"
+#include "profile.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define PROFILE_HIST_BUCKET				40					// 1ns .. ~18 min
+
+bool					g_ProfileEnable		= false;
+
+static u64				s_Cycles[PROFILE_STAGE_MAX];		// inclusive cycles per stage
+static u64				s_Count[PROFILE_STAGE_MAX];
+static u64				s_CyclesLast[PROFILE_STAGE_MAX];	// at the last status print
+static u64				s_StatusTSC			= 0;
+
+static u64				s_Hist[PROFILE_HIST_MAX][PROFILE_HIST_BUCKET];
+static u64				s_HistMax[PROFILE_HIST_MAX];		// max latency in ns
+
+static const u8*		s_StageName[PROFILE_STAGE_MAX]	= { "input", "split", "write", "roll", "hook" };
+static const u8*		s_HistName[PROFILE_HIST_MAX]	= { "write", "roll" };
+
+//---------------------------------------------------------------------------------------------
+
+void Profile_Init(void)
+{
+	CycleCalibration();
+
+	g_ProfileEnable	= true;
+	s_StatusTSC		= rdtsc();
+}
+
+void Profile_Add(u32 Stage, u64 Cycles)
+{
+	s_Cycles[Stage] += Cycles;
+	s_Count[Stage]	+= 1;
+}
+
+void Profile_Hist(u32 Hist, u64 Cycles)
+{
+	u64 NS = tsc2ns(Cycles);
+
+	u32 Bucket = (NS == 0) ? 0 : 64 - __builtin_clzll(NS);
+	if (Bucket >= PROFILE_HIST_BUCKET) Bucket = PROFILE_HIST_BUCKET - 1;
+
+	s_Hist[Hist][Bucket]++;
+	if (NS > s_HistMax[Hist]) s_HistMax[Hist] = NS;
+}
+
+//---------------------------------------------------------------------------------------------
+
+// exclusive cycles per stage from the inclusive counters
+static void Exclusive(u64* Cycles, u64* Out)
+{
+	for (int i=0; i < PROFILE_STAGE_MAX; i++) Out[i] = Cycles[i];
+
+	Out[PROFILE_ROLL]	= (Cycles[PROFILE_ROLL] > Cycles[PROFILE_HOOK]) ? Cycles[PROFILE_ROLL] - Cycles[PROFILE_HOOK] : 0;
+
+	u64 Nested			= Cycles[PROFILE_WRITE] + Cycles[PROFILE_ROLL];
+	Out[PROFILE_SPLIT]	= (Cycles[PROFILE_SPLIT] > Nested) ? Cycles[PROFILE_SPLIT] - Nested : 0;
+}
+
+// upper bound of the bucket holding the Pct percentile, in ns
+static u64 HistPercentile(u32 Hist, float Pct)
+{
+	u64 Total = 0;
+	for (int i=0; i < PROFILE_HIST_BUCKET; i++) Total += s_Hist[Hist][i];
+	if (Total == 0) return 0;
+
+	u64 Target	= ceil(Total * Pct);
+	u64 Sum		= 0;
+	for (int i=0; i < PROFILE_HIST_BUCKET; i++)
+	{
+		Sum += s_Hist[Hist][i];
+		if (Sum >= Target) return (i == 0) ? 1 : (1ULL << i);
+	}
+	return s_HistMax[Hist];
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Profile_Status(u8* Str)
+{
+	Str[0] = 0;
+	if (!g_ProfileEnable) return;
+
+	u64 TSC		= rdtsc();
+	u64 dTSC	= TSC - s_StatusTSC;
+	s_StatusTSC	= TSC;
+
+	u64 Delta[PROFILE_STAGE_MAX];
+	for (int i=0; i < PROFILE_STAGE_MAX; i++)
+	{
+		Delta[i]		= s_Cycles[i] - s_CyclesLast[i];
+		s_CyclesLast[i]	= s_Cycles[i];
+	}
+
+	u64 Excl[PROFILE_STAGE_MAX];
+	Exclusive(Delta, Excl);
+
+	u8* S = Str;
+	S += sprintf(S, "Profile");
+	for (int i=0; i < PROFILE_STAGE_MAX; i++)
+	{
+		S += sprintf(S, " %s %4.1f%%", s_StageName[i], (dTSC > 0) ? 100.0 * Excl[i] / dTSC : 0.0);
+	}
+	S += sprintf(S, " | write p99 %.3fus max %.3fus roll p99 %.3fms max %.3fms",
+			HistPercentile(PROFILE_HIST_WRITE, 0.99) / 1e3,
+			s_HistMax[PROFILE_HIST_WRITE] / 1e3,
+			HistPercentile(PROFILE_HIST_ROLL, 0.99) / 1e6,
+			s_HistMax[PROFILE_HIST_ROLL] / 1e6);
+}
+
+void Profile_WriteJSON(FILE* F)
+{
+	u64 Excl[PROFILE_STAGE_MAX];
+	Exclusive(s_Cycles, Excl);
+
+	fprintf(F, "\"profile\":{\"enabled\":%i", g_ProfileEnable);
+	if (g_ProfileEnable)
+	{
+		fprintf(F, ",\"stage\":{");
+		for (int i=0; i < PROFILE_STAGE_MAX; i++)
+		{
+			fprintf(F, "%s\"%s\":{\"ns\":%lli,\"count\":%lli}", (i == 0) ? "" : ",", s_StageName[i], tsc2ns(Excl[i]), s_Count[i]);
+		}
+		fprintf(F, "},\"hist\":{");
+		for (int h=0; h < PROFILE_HIST_MAX; h++)
+		{
+			fprintf(F, "%s\"%s\":{\"p50_ns\":%lli,\"p99_ns\":%lli,\"max_ns\":%lli,\"log2_ns\":[",
+					(h == 0) ? "" : ",",
+					s_HistName[h],
+					HistPercentile(h, 0.50),
+					HistPercentile(h, 0.99),
+					s_HistMax[h]);
+
+			for (int i=0; i < PROFILE_HIST_BUCKET; i++)
+			{
+				fprintf(F, "%s%lli", (i == 0) ? "" : ",", s_Hist[h][i]);
+			}
+			fprintf(F, "]}");
+		}
+		fprintf(F, "}");
+	}
+	fprintf(F, "}");
+}
@@ -0,0 +1,37 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// per stage cycle counters and latency histograms
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#define PROFILE_INPUT					0					// reading / decoding input packets
+#define PROFILE_SPLIT					1					// split decision and bookkeeping
+#define PROFILE_WRITE					2					// Output_Write
+#define PROFILE_ROLL					3					// closing / opening splits, excluding hooks
+#define PROFILE_HOOK					4					// scripts and rename commands
+#define PROFILE_STAGE_MAX				5
+
+#define PROFILE_HIST_WRITE				0					// latency of each Output_Write
+#define PROFILE_HIST_ROLL				1					// latency of each split roll
+#define PROFILE_HIST_MAX				2
+
+extern bool			g_ProfileEnable;
+
+// calibrates the TSC, takes ~1 sec
+void				Profile_Init		(void);
+
+void				Profile_Add			(u32 Stage, u64 Cycles);
+void				Profile_Hist		(u32 Hist, u64 Cycles);
+
+// stage breakdown since the last call, for the status line
+void				Profile_Status		(u8* Str);
+
+// "profile" object for the stats file
+void				Profile_WriteJSON	(FILE* F);
+
+#endif
@@ -0,0 +1,140 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// bounded packet reorder buffer
+//
+// merged multi port captures are only approximately time ordered. holding the last N packets
+// in a min heap keyed on timestamp re-sorts any disorder smaller than N packets before it
+// reaches the splitter. packets with equal timestamps keep their arrival order.
+//
+// each slot owns a buffer that only grows, so after warm up there is no allocation
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fTypes.h"
+#include "reorder.h"
+
+//---------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	s64					TS;									// packet timestamp
+	u64					Seq;								// arrival order, tie break
+	u32					Length;								// bytes in Data
+	u32					Alloc;								// bytes allocated
+	u8					IsRoll;								// start a new split with this packet
+	u8*					Data;
+
+} ReorderSlot_t;
+
+typedef struct Reorder_t
+{
+	u32					Max;
+	u32					Count;
+	u64					Seq;
+
+	ReorderSlot_t*		Slot;
+	ReorderSlot_t**		Heap;								// min heap of slots
+
+	ReorderSlot_t**		Free;								// free slot stack
+	u32					FreeCnt;
+
+} Reorder_t;
+
+//---------------------------------------------------------------------------------------------
+
+static INLINE bool SlotLess(ReorderSlot_t* A, ReorderSlot_t* B)
+{
+	if (A->TS != B->TS) return A->TS < B->TS;
+	return A->Seq < B->Seq;
+}
+
+Reorder_t* Reorder_Create(u32 Max)
+{
+	Reorder_t* R = calloc(1, sizeof(Reorder_t));
+	assert(R != NULL);
+
+	R->Max		= Max;
+	R->Slot		= calloc(Max, sizeof(ReorderSlot_t));
+	R->Heap		= calloc(Max, sizeof(ReorderSlot_t*));
+	R->Free		= calloc(Max, sizeof(ReorderSlot_t*));
+	assert(R->Slot && R->Heap && R->Free);
+
+	for (int i=0; i < Max; i++)
+	{
+		R->Free[R->FreeCnt++] = &R->Slot[i];
+	}
+	return R;
+}
+
+//---------------------------------------------------------------------------------------------
+
+bool Reorder_Push(Reorder_t* R, s64 TS, void* Pkt, u32 Length, bool IsRoll)
+{
+	assert(R->Count < R->Max);
+
+	ReorderSlot_t* S = R->Free[--R->FreeCnt];
+	if (S->Alloc < Length)
+	{
+		S->Alloc	= Length;
+		S->Data		= realloc(S->Data, S->Alloc);
+		assert(S->Data != NULL);
+	}
+	memcpy(S->Data, Pkt, Length);
+	S->Length	= Length;
+	S->IsRoll	= IsRoll;
+	S->TS		= TS;
+	S->Seq		= R->Seq++;
+
+	// sift up
+	u32 i = R->Count++;
+	while (i > 0)
+	{
+		u32 Parent = (i - 1) / 2;
+		if (!SlotLess(S, R->Heap[Parent])) break;
+
+		R->Heap[i] = R->Heap[Parent];
+		i = Parent;
+	}
+	R->Heap[i] = S;
+
+	return (R->Count == R->Max);
+}
+
+s64 Reorder_Pop(Reorder_t* R, void* Pkt, u8* pIsRoll)
+{
+	assert(R->Count > 0);
+
+	ReorderSlot_t* Top = R->Heap[0];
+	memcpy(Pkt, Top->Data, Top->Length);
+	pIsRoll[0] = Top->IsRoll;
+	R->Free[R->FreeCnt++] = Top;
+
+	// sift down the last entry
+	ReorderSlot_t* S = R->Heap[--R->Count];
+	u32 i = 0;
+	while (true)
+	{
+		u32 Child = 2 * i + 1;
+		if (Child >= R->Count) break;
+		if ((Child + 1 < R->Count) && SlotLess(R->Heap[Child + 1], R->Heap[Child])) Child++;
+		if (!SlotLess(R->Heap[Child], S)) break;
+
+		R->Heap[i] = R->Heap[Child];
+		i = Child;
+	}
+	if (R->Count > 0) R->Heap[i] = S;
+
+	return Top->TS;
+}
+
+u32 Reorder_Count(Reorder_t* R)
+{
+	return R->Count;
+}
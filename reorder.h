@@ -0,0 +1,25 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// bounded packet reorder buffer
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+struct Reorder_t;
+
+struct Reorder_t*	Reorder_Create		(u32 Max);
+
+// returns true when the buffer is full and a packet should be popped. IsRoll travels
+// with the packet, a plugin roll request applies to the packet it was made for
+bool				Reorder_Push		(struct Reorder_t* R, s64 TS, void* Pkt, u32 Length, bool IsRoll);
+
+// pop the oldest packet into Pkt, returns its timestamp and roll request
+s64					Reorder_Pop			(struct Reorder_t* R, void* Pkt, u8* pIsRoll);
+
+u32					Reorder_Count		(struct Reorder_t* R);
+
+#endif
@@ -0,0 +1,115 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// corrupt pcap stream resynchronisation
+//
+// after a bad packet header the stream is scanned forward for the next offset that starts a
+// chain of plausible headers: timestamp close to the last good packet, sane lengths, and each
+// header followed by another valid header exactly LengthCapture bytes later.
+//
+// the capture timestamp seconds change slowly, so the upper 16 bits of Sec are the same for
+// every packet within ~18 hours. SSE2 compares 16 bytes at a time for that byte pair and only
+// the (rare) matches are validated in full
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fTypes.h"
+#include "resync.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define PKT_HEADER_SIZE					16					// Sec, NSec, LengthCapture, LengthWire
+#define PKT_LENGTH_MAX					(128*1024)
+
+static INLINE bool HeaderValid(u8* Header, u32 LastSec, u32 SubSecMax)
+{
+	u32* H = (u32*)Header;
+
+	u32 Sec				= H[0];
+	u32 SubSec			= H[1];
+	u32 LengthCapture	= H[2];
+	u32 LengthWire		= H[3];
+
+	if ((Sec + RESYNC_TS_BEFORE < LastSec) || (Sec > LastSec + RESYNC_TS_AFTER)) return false;
+	if (SubSec >= SubSecMax) return false;
+	if ((LengthCapture == 0) || (LengthCapture > PKT_LENGTH_MAX)) return false;
+	if ((LengthWire < LengthCapture) || (LengthWire > PKT_LENGTH_MAX)) return false;
+
+	return true;
+}
+
+// candidate plus the following headers it points to
+static bool ChainValid(u8* Buf, u32 Length, u32 Offset, u32 LastSec, u32 SubSecMax, bool IsEOF)
+{
+	for (int i=0; i < RESYNC_CHAIN; i++)
+	{
+		// ran out of buffer with every header so far valid
+		if (Offset + PKT_HEADER_SIZE > Length) return IsEOF && (i > 0) && (Offset == Length);
+
+		if (!HeaderValid(Buf + Offset, LastSec, SubSecMax)) return false;
+
+		u32 Sec = ((u32*)(Buf + Offset))[0];
+		if (Sec > LastSec) LastSec = Sec;
+
+		Offset += PKT_HEADER_SIZE + ((u32*)(Buf + Offset))[2];
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+
+s64 Resync_Scan(u8* Buf, u32 Length, u32 LastSec, u32 SubSecMax, bool IsEOF)
+{
+	// upper bytes of Sec for the last packet and the next 64K second period
+	u8 Hi2[2] = { (LastSec >> 16) & 0xff, ((LastSec >> 16) + 1) & 0xff };
+	u8 Hi3[2] = { (LastSec >> 24) & 0xff, ((LastSec >> 16) + 1) >> 8 & 0xff };
+
+	// Sec bytes 2,3 sit at header offset 2,3
+	u32 Pos = 0;
+
+#ifdef __SSE2__
+	__m128i B2a = _mm_set1_epi8(Hi2[0]);
+	__m128i B3a = _mm_set1_epi8(Hi3[0]);
+	__m128i B2b = _mm_set1_epi8(Hi2[1]);
+	__m128i B3b = _mm_set1_epi8(Hi3[1]);
+
+	while (Pos + 2 + 16 + 1 <= Length)
+	{
+		__m128i V2 = _mm_loadu_si128((__m128i*)(Buf + Pos + 2));
+		__m128i V3 = _mm_loadu_si128((__m128i*)(Buf + Pos + 3));
+
+		__m128i Ma = _mm_and_si128(_mm_cmpeq_epi8(V2, B2a), _mm_cmpeq_epi8(V3, B3a));
+		__m128i Mb = _mm_and_si128(_mm_cmpeq_epi8(V2, B2b), _mm_cmpeq_epi8(V3, B3b));
+		u32 Mask = _mm_movemask_epi8(_mm_or_si128(Ma, Mb));
+
+		while (Mask)
+		{
+			u32 i = __builtin_ctz(Mask);
+			Mask &= Mask - 1;
+
+			if (ChainValid(Buf, Length, Pos + i, LastSec, SubSecMax, IsEOF)) return Pos + i;
+		}
+		Pos += 16;
+	}
+#endif
+
+	// tail, or no SSE2
+	for (; Pos + PKT_HEADER_SIZE <= Length; Pos++)
+	{
+		u8 B2 = Buf[Pos + 2];
+		u8 B3 = Buf[Pos + 3];
+		if (!(((B2 == Hi2[0]) && (B3 == Hi3[0])) || ((B2 == Hi2[1]) && (B3 == Hi3[1])))) continue;
+
+		if (ChainValid(Buf, Length, Pos, LastSec, SubSecMax, IsEOF)) return Pos;
+	}
+	return -1;
+}
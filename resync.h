@@ -0,0 +1,21 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// corrupt pcap stream resynchronisation
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __RESYNC_H__
+#define __RESYNC_H__
+
+#define RESYNC_CHAIN					4					// consecutive headers that must validate
+#define RESYNC_TS_BEFORE				60					// seconds a candidate may be before the last good packet
+#define RESYNC_TS_AFTER					3600				// seconds a candidate may be after the last good packet
+
+// find the first offset in Buf that starts a plausible chain of pcap packet headers
+// LastSec is the timestamp of the last good packet, SubSecMax 1e9 for nsec 1e6 for usec pcaps
+// IsEOF allows a chain that runs into the end of the buffer. returns -1 if nothing found
+s64					Resync_Scan			(u8* Buf, u32 Length, u32 LastSec, u32 SubSecMax, bool IsEOF);
+
+#endif
@@ -0,0 +1,386 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// rolling retention of closed splits
+//
+// keeps the output directory bounded by split count, total split bytes and/or filesystem
+// usage. closed splits are tracked oldest first (existing files whose name parses as a split name
+// are picked up at startup), and once a limit is exceeded the oldest are handed to a
+// background thread that deletes them or runs a user hook, so an unlink of a multi GB file
+// never stalls the capture loop.
+//
+// recycle mode instead renames the oldest split to the next split`s pending name so the
+// writer overwrites the already allocated extents, avoiding filesystem fragmentation
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "fTypes.h"
+#include "retain.h"
+#include "filename.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define RETAIN_QUEUE_MAX				256					// max pending deletes
+
+typedef struct
+{
+	u8					Name[1024];
+	u64					Size;
+	u64					MTime;
+
+} RetainFile_t;
+
+static RetainConfig_t	s_Config;
+static bool				s_IsOpen			= false;
+static u8				s_Dir[1024];						// output directory for statvfs
+
+// closed splits, oldest first
+static RetainFile_t*	s_File				= NULL;
+static u32				s_FileMax			= 0;
+static u32				s_FileHead			= 0;
+static u32				s_FileCnt			= 0;
+static u64				s_FileByte			= 0;
+
+// delete queue serviced by the background thread
+static pthread_t		s_Thread;
+static pthread_mutex_t	s_Lock				= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	s_Cond				= PTHREAD_COND_INITIALIZER;
+static u8				s_Queue[RETAIN_QUEUE_MAX][1024];
+static u32				s_QueuePut			= 0;
+static u32				s_QueueGet			= 0;
+static volatile u32		s_QueueDepth		= 0;
+static volatile bool	s_ThreadExit		= false;
+
+static volatile u64		s_DeleteCnt			= 0;				// splits removed
+
+//---------------------------------------------------------------------------------------------
+// delete or hand off a single split
+
+static void RetainRemove(u8* FileName)
+{
+	if (s_Config.HookCmd)
+	{
+		u8 Cmd[4096];
+		sprintf(Cmd, "%s \"%s\"", s_Config.HookCmd, FileName);
+		printf("Retain Script [%s]\n", Cmd);
+		system(Cmd);
+	}
+	else
+	{
+		if (unlink(FileName) != 0)
+		{
+			fprintf(stderr, "Retain failed to delete [%s] %i %s\n", FileName, errno, strerror(errno));
+		}
+	}
+	__atomic_add_fetch(&s_DeleteCnt, 1, __ATOMIC_RELAXED);
+}
+
+static void* RetainThread(void* User)
+{
+	u8 FileName[1024];
+	while (true)
+	{
+		pthread_mutex_lock(&s_Lock);
+		while ((s_QueueDepth == 0) && !s_ThreadExit)
+		{
+			pthread_cond_wait(&s_Cond, &s_Lock);
+		}
+		if (s_QueueDepth == 0)
+		{
+			pthread_mutex_unlock(&s_Lock);
+			break;
+		}
+		strcpy(FileName, s_Queue[s_QueueGet]);
+		s_QueueGet = (s_QueueGet + 1) % RETAIN_QUEUE_MAX;
+		pthread_mutex_unlock(&s_Lock);
+
+		RetainRemove(FileName);
+
+		// only decrement once the space is actually released
+		__atomic_sub_fetch(&s_QueueDepth, 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+// queue for async removal, removes inline if the queue is backed up
+static void RetainQueue(u8* FileName)
+{
+	pthread_mutex_lock(&s_Lock);
+	if (s_QueueDepth >= RETAIN_QUEUE_MAX)
+	{
+		pthread_mutex_unlock(&s_Lock);
+		RetainRemove(FileName);
+		return;
+	}
+	strcpy(s_Queue[s_QueuePut], FileName);
+	s_QueuePut = (s_QueuePut + 1) % RETAIN_QUEUE_MAX;
+	__atomic_add_fetch(&s_QueueDepth, 1, __ATOMIC_RELEASE);
+
+	pthread_cond_signal(&s_Cond);
+	pthread_mutex_unlock(&s_Lock);
+}
+
+//---------------------------------------------------------------------------------------------
+// oldest first split list
+
+static void FilePush(u8* Name, u64 Size, u64 MTime)
+{
+	if (s_FileCnt == s_FileMax)
+	{
+		// grow and unwrap
+		u32 Max = (s_FileMax == 0) ? 1024 : s_FileMax * 2;
+		RetainFile_t* File = malloc(Max * sizeof(RetainFile_t));
+		assert(File != NULL);
+
+		for (int i=0; i < s_FileCnt; i++)
+		{
+			File[i] = s_File[(s_FileHead + i) % s_FileMax];
+		}
+		free(s_File);
+
+		s_File		= File;
+		s_FileMax	= Max;
+		s_FileHead	= 0;
+	}
+
+	RetainFile_t* F = &s_File[(s_FileHead + s_FileCnt) % s_FileMax];
+	strncpy(F->Name, Name, sizeof(F->Name) - 1);
+	F->Size		= Size;
+	F->MTime	= MTime;
+
+	s_FileCnt++;
+	s_FileByte += Size;
+}
+
+static RetainFile_t* FilePop(void)
+{
+	if (s_FileCnt == 0) return NULL;
+
+	RetainFile_t* F = &s_File[s_FileHead];
+	s_FileHead = (s_FileHead + 1) % s_FileMax;
+	s_FileCnt--;
+	s_FileByte -= F->Size;
+
+	return F;
+}
+
+static int FileCompare(const void* A, const void* B)
+{
+	const RetainFile_t* FA = A;
+	const RetainFile_t* FB = B;
+
+	if (FA->MTime != FB->MTime) return (FA->MTime < FB->MTime) ? -1 : 1;
+	return strcmp(FA->Name, FB->Name);
+}
+
+//---------------------------------------------------------------------------------------------
+
+static float FileSystemUsedPct(void)
+{
+	struct statvfs FS;
+	if (statvfs(s_Dir, &FS) != 0) return 0;
+	if (FS.f_blocks == 0) return 0;
+
+	return 100.0 * (1.0 - FS.f_bavail / (double)FS.f_blocks);
+}
+
+static bool IsOverLimit(bool IsAdding)
+{
+	u32 Extra = IsAdding ? 1 : 0;
+
+	if ((s_Config.MaxCount > 0) && (s_FileCnt + Extra > s_Config.MaxCount)) return true;
+	if ((s_Config.MaxByte  > 0) && (s_FileByte > s_Config.MaxByte)) return true;
+
+	// only once previous deletes have released their space
+	if ((s_Config.MaxPct > 0) && (s_QueueDepth == 0) && (FileSystemUsedPct() > s_Config.MaxPct)) return true;
+
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------
+// BaseName / Suffix identify existing splits to pick up from a previous run
+
+void Retain_Open(RetainConfig_t* Config, u8* BaseName, u8* Suffix)
+{
+	s_Config = Config[0];
+
+	// split base into directory + filename prefix
+	u8 Prefix[1024];
+	u8* Slash = strrchr(BaseName, '/');
+	if (Slash)
+	{
+		u32 Len = Slash - BaseName;
+		memcpy(s_Dir, BaseName, Len);
+		s_Dir[Len] = 0;
+		if (Len == 0) strcpy(s_Dir, "/");
+		strcpy(Prefix, Slash + 1);
+	}
+	else
+	{
+		strcpy(s_Dir, ".");
+		strcpy(Prefix, BaseName);
+	}
+
+	// existing splits oldest first
+	RetainFile_t* List	= NULL;
+	u32 ListCnt			= 0;
+	u32 ListMax			= 0;
+
+	DIR* D = opendir(s_Dir);
+	if (D)
+	{
+		u32 PrefixLen = strlen(Prefix);
+		u32 SuffixLen = strlen(Suffix);
+
+		struct dirent* E;
+		while ((E = readdir(D)) != NULL)
+		{
+			u32 Len = strlen(E->d_name);
+			if (Len < PrefixLen + SuffixLen) continue;
+			if (memcmp(E->d_name, Prefix, PrefixLen) != 0) continue;
+			if (strcmp(E->d_name + Len - SuffixLen, Suffix) != 0) continue;
+
+			// only names this splitter generates, not other files sharing the prefix
+			if (!FileName_Match(E->d_name + PrefixLen, Len - PrefixLen - SuffixLen)) continue;
+
+			u8 Path[2048];
+			sprintf(Path, "%s/%s", s_Dir, E->d_name);
+			if (!Slash) strcpy(Path, E->d_name);
+
+			struct stat st;
+			if (stat(Path, &st) != 0) continue;
+			if (!S_ISREG(st.st_mode)) continue;
+
+			if (ListCnt == ListMax)
+			{
+				ListMax = (ListMax == 0) ? 1024 : ListMax * 2;
+				List = realloc(List, ListMax * sizeof(RetainFile_t));
+				assert(List != NULL);
+			}
+			RetainFile_t* F = &List[ListCnt++];
+			strncpy(F->Name, Path, sizeof(F->Name) - 1);
+			F->Name[sizeof(F->Name) - 1] = 0;
+			F->Size		= st.st_size;
+			F->MTime	= (u64)st.st_mtim.tv_sec * k1E9 + st.st_mtim.tv_nsec;
+		}
+		closedir(D);
+	}
+
+	qsort(List, ListCnt, sizeof(RetainFile_t), FileCompare);
+	for (int i=0; i < ListCnt; i++)
+	{
+		FilePush(List[i].Name, List[i].Size, List[i].MTime);
+	}
+	free(List);
+
+	pthread_create(&s_Thread, NULL, RetainThread, NULL);
+	s_IsOpen = true;
+
+	fprintf(stderr, "Retain: Dir [%s] MaxCount %i MaxByte %.3f GB MaxPct %.1f%% Hook [%s] Recycle %i. Existing Splits %i %.3f GB\n",
+			s_Dir,
+			s_Config.MaxCount,
+			s_Config.MaxByte / 1e9,
+			s_Config.MaxPct,
+			s_Config.HookCmd ? s_Config.HookCmd : (u8*)"",
+			s_Config.IsRecycle,
+			s_FileCnt,
+			s_FileByte / 1e9);
+
+	Retain_Check();
+}
+
+// wait for queued deletes to finish
+void Retain_Close(void)
+{
+	if (!s_IsOpen) return;
+
+	pthread_mutex_lock(&s_Lock);
+	s_ThreadExit = true;
+	pthread_cond_signal(&s_Cond);
+	pthread_mutex_unlock(&s_Lock);
+
+	pthread_join(s_Thread, NULL);
+	s_IsOpen = false;
+}
+
+//---------------------------------------------------------------------------------------------
+// register a closed split
+
+void Retain_Add(u8* FileName)
+{
+	struct stat st;
+	if (stat(FileName, &st) != 0) return;
+
+	FilePush(FileName, st.st_size, (u64)st.st_mtim.tv_sec * k1E9 + st.st_mtim.tv_nsec);
+}
+
+// hand the oldest splits to the delete thread until under all limits
+void Retain_Check(void)
+{
+	if (!s_IsOpen) return;
+
+	while ((s_FileCnt > 0) && IsOverLimit(false))
+	{
+		RetainFile_t* F = FilePop();
+		RetainQueue(F->Name);
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// when the next split would exceed a limit move the oldest split to FileName so its
+// blocks are reused. returns true if FileName now holds a recycled file
+
+bool Retain_Recycle(u8* FileName)
+{
+	if (!s_IsOpen || !s_Config.IsRecycle) return false;
+	if ((s_FileCnt == 0) || !IsOverLimit(true)) return false;
+
+	RetainFile_t* F = FilePop();
+	if (rename(F->Name, FileName) != 0)
+	{
+		fprintf(stderr, "Retain failed to recycle [%s] %i %s\n", F->Name, errno, strerror(errno));
+		RetainQueue(F->Name);
+		return false;
+	}
+	__atomic_add_fetch(&s_DeleteCnt, 1, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+// out of space, synchronously remove the oldest split. false if nothing is left to remove
+
+bool Retain_Reclaim(void)
+{
+	if (!s_IsOpen) return false;
+
+	RetainFile_t* F = FilePop();
+	if (F == NULL) return false;
+
+	printf("Retain: out of space, removing [%s]\n", F->Name);
+	RetainRemove(F->Name);
+
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Retain_Stats(u32* pCount, u64* pByte, u64* pDeleteCnt, u32* pQueueDepth)
+{
+	if (pCount)			pCount[0]		= s_FileCnt;
+	if (pByte)			pByte[0]		= s_FileByte;
+	if (pDeleteCnt)		pDeleteCnt[0]	= s_DeleteCnt;
+	if (pQueueDepth)	pQueueDepth[0]	= s_QueueDepth;
+}
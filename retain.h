@@ -0,0 +1,33 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// rolling retention of closed splits
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __RETAIN_H__
+#define __RETAIN_H__
+
+typedef struct
+{
+	u32				MaxCount;							// keep at most this many splits
+	u64				MaxByte;							// keep at most this many bytes of splits
+	float			MaxPct;								// keep filesystem usage below this pct
+
+	u8*				HookCmd;							// run "HookCmd <file>" instead of deleting
+	bool			IsRecycle;							// reuse the oldest file for the next split
+
+} RetainConfig_t;
+
+void				Retain_Open			(RetainConfig_t* Config, u8* BaseName, u8* Suffix);
+void				Retain_Close		(void);
+
+void				Retain_Add			(u8* FileName);
+void				Retain_Check		(void);
+bool				Retain_Recycle		(u8* FileName);
+bool				Retain_Reclaim		(void);
+
+void				Retain_Stats		(u32* pCount, u64* pByte, u64* pDeleteCnt, u32* pQueueDepth);
+
+#endif
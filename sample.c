@@ -0,0 +1,198 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// packet sampling and output rate cap
+//
+// count sampling keeps every Nth packet. flow sampling hashes the ip 5 tuple (symmetric, so
+// both directions land together) and keeps whole flows whose hash falls in 1/N of the space,
+// non ip traffic is hashed on the mac pair. the rate cap is a token bucket refilled by
+// packet timestamps rather than wall time, so replaying a capture gives the same output
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fTypes.h"
+#include "sample.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define SAMPLE_BURST_NS					100e6				// rate cap bucket holds this much time
+
+#define ETHER_TYPE_IPV4					0x0800
+#define ETHER_TYPE_IPV6					0x86dd
+#define ETHER_TYPE_VLAN					0x8100
+#define ETHER_TYPE_QINQ					0x88a8
+
+#define IP_PROTO_TCP					6
+#define IP_PROTO_UDP					17
+#define IP_PROTO_SCTP					132
+
+static SampleConfig_t	s_Config;
+
+static u64				s_Seq			= 0;				// count sampling position
+
+static double			s_Token			= 0;				// rate cap bytes available
+static double			s_TokenMax		= 0;
+static s64				s_TokenTS		= 0;				// timestamp of the last refill
+
+static u64				s_KeepPkt		= 0;
+static u64				s_SampleDrop	= 0;
+static u64				s_RateDrop		= 0;
+
+//---------------------------------------------------------------------------------------------
+
+static INLINE u64 Mix64(u64 x)
+{
+	// murmur3 finalizer
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static INLINE u16 Load16BE(u8* p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static INLINE u64 Load64(u8* p, u32 Length)
+{
+	u64 v = 0;
+	memcpy(&v, p, Length);
+	return v;
+}
+
+// symmetric flow hash, src and dst are summed so A->B and B->A match
+static u64 FlowHash(u8* Payload, u32 Length)
+{
+	if (Length < 14) return 0;
+
+	u64 Hash	= Mix64(Load64(Payload, 6) + Load64(Payload + 6, 6));
+	u32 Type	= Load16BE(Payload + 12);
+	u32 Pos		= 14;
+
+	// up to 2 vlan tags
+	for (int i=0; i < 2; i++)
+	{
+		if ((Type != ETHER_TYPE_VLAN) && (Type != ETHER_TYPE_QINQ)) break;
+		if (Pos + 4 > Length) return Hash;
+
+		Type = Load16BE(Payload + Pos + 2);
+		Pos += 4;
+	}
+
+	u32 Proto	= 0;
+	u64 Addr	= 0;
+	bool IsPort	= false;
+	switch (Type)
+	{
+	case ETHER_TYPE_IPV4:
+	{
+		if (Pos + 20 > Length) return Hash;
+		u8* IP		= Payload + Pos;
+
+		Proto		= IP[9];
+		Addr		= Load64(IP + 12, 4) + Load64(IP + 16, 4);
+
+		// only the first fragment has ports, so all fragments hash on addresses to stay together
+		IsPort		= (Load16BE(IP + 6) & 0x3fff) == 0;
+		Pos			+= (IP[0] & 0xf) * 4;
+	}
+	break;
+
+	case ETHER_TYPE_IPV6:
+	{
+		if (Pos + 40 > Length) return Hash;
+		u8* IP		= Payload + Pos;
+
+		// extension headers are not walked, their flows hash on addresses only
+		Proto		= IP[6];
+		Addr		= Load64(IP +  8, 8) + Load64(IP + 16, 8) + Load64(IP + 24, 8) + Load64(IP + 32, 8);
+		IsPort		= true;
+		Pos			+= 40;
+	}
+	break;
+
+	default:
+		return Hash;
+	}
+
+	u32 Port = 0;
+	if (IsPort && ((Proto == IP_PROTO_TCP) || (Proto == IP_PROTO_UDP) || (Proto == IP_PROTO_SCTP)) && (Pos + 4 <= Length))
+	{
+		Port = Load16BE(Payload + Pos) + Load16BE(Payload + Pos + 2);
+	}
+	return Mix64(Addr ^ Mix64(((u64)Proto << 32) | Port));
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Sample_Open(SampleConfig_t* Config)
+{
+	s_Config = *Config;
+	if (s_Config.Rate == 0) s_Config.Rate = 1;
+
+	// bucket starts full
+	s_TokenMax	= (s_Config.RateLimit / 8.0) * (SAMPLE_BURST_NS / 1e9);
+	s_Token		= s_TokenMax;
+	s_TokenTS	= 0;
+}
+
+bool Sample_Packet(s64 TS, u8* Payload, u32 LengthCapture, u32 Length)
+{
+	switch (s_Config.Mode)
+	{
+	case SAMPLE_MODE_COUNT:
+		if ((s_Seq++ % s_Config.Rate) != 0)
+		{
+			s_SampleDrop++;
+			return false;
+		}
+		break;
+
+	case SAMPLE_MODE_FLOW:
+		if ((FlowHash(Payload, LengthCapture) % s_Config.Rate) != 0)
+		{
+			s_SampleDrop++;
+			return false;
+		}
+		break;
+	}
+
+	if (s_Config.RateLimit > 0)
+	{
+		// refill from capture time, out of order packets add nothing
+		if ((s_TokenTS != 0) && (TS > s_TokenTS))
+		{
+			s_Token += (TS - s_TokenTS) * (s_Config.RateLimit / 8e9);
+			if (s_Token > s_TokenMax) s_Token = s_TokenMax;
+		}
+		if (TS > s_TokenTS) s_TokenTS = TS;
+
+		if (s_Token < Length)
+		{
+			s_RateDrop++;
+			return false;
+		}
+		s_Token -= Length;
+	}
+
+	s_KeepPkt++;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Sample_Stats(u64* pKeepPkt, u64* pSampleDrop, u64* pRateDrop)
+{
+	if (pKeepPkt)		pKeepPkt[0]		= s_KeepPkt;
+	if (pSampleDrop)	pSampleDrop[0]	= s_SampleDrop;
+	if (pRateDrop)		pRateDrop[0]	= s_RateDrop;
+}
@@ -0,0 +1,31 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// packet sampling and output rate cap
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __SAMPLE_H__
+#define __SAMPLE_H__
+
+#define SAMPLE_MODE_NONE				0
+#define SAMPLE_MODE_COUNT				1					// keep every Nth packet
+#define SAMPLE_MODE_FLOW				2					// keep 1 in N flows, all packets of a kept flow
+
+typedef struct
+{
+	u32				Mode;								// SAMPLE_MODE_*
+	u32				Rate;								// keep 1 in Rate
+	u64				RateLimit;							// output cap in bits per sec of capture time, 0 for none
+
+} SampleConfig_t;
+
+void				Sample_Open			(SampleConfig_t* Config);
+
+// true if the packet should be written. Length is the bytes it costs in the output
+bool				Sample_Packet		(s64 TS, u8* Payload, u32 LengthCapture, u32 Length);
+
+void				Sample_Stats		(u64* pKeepPkt, u64* pSampleDrop, u64* pRateDrop);
+
+#endif
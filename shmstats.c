@@ -0,0 +1,158 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// live stats published in a shared memory block
+//
+// the splitter maps a small fixed layout struct (normally under /dev/shm) and updates it
+// with a seqlock every batch of packets and on every split roll, so there is no lock or
+// syscall on the hot path. monitoring maps the same file read only and copies the block,
+// retrying if a write was in progress. pcap_split --stats-dump prints it as Prometheus text
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "fTypes.h"
+#include "shmstats.h"
+
+//---------------------------------------------------------------------------------------------
+
+ShmStats_t* ShmStats_Open(u8* Path)
+{
+	int fd = open(Path, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		fprintf(stderr, "stats shm [%s] open failed %i %s\n", Path, errno, strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(ShmStats_t)) != 0)
+	{
+		fprintf(stderr, "stats shm [%s] truncate failed %i %s\n", Path, errno, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	ShmStats_t* S = mmap(NULL, sizeof(ShmStats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (S == MAP_FAILED)
+	{
+		fprintf(stderr, "stats shm [%s] map failed %i %s\n", Path, errno, strerror(errno));
+		return NULL;
+	}
+
+	// keep the sequence moving forward across restarts, readers may still be mapped
+	u32 Seq = (S->Magic == SHMSTATS_MAGIC) ? (S->Seq + 2) & ~1 : 0;
+
+	memset(S, 0, sizeof(ShmStats_t));
+	S->Seq			= Seq;
+	S->Version		= SHMSTATS_VERSION;
+	S->PID			= getpid();
+	S->IsRunning	= 1;
+	S->StartTS		= clock_ns();
+	__atomic_store_n(&S->Magic, SHMSTATS_MAGIC, __ATOMIC_RELEASE);
+
+	fprintf(stderr, "stats shm [%s] %i bytes\n", Path, (u32)sizeof(ShmStats_t));
+	return S;
+}
+
+//---------------------------------------------------------------------------------------------
+// consistent copy of the block, prints Prometheus text exposition format
+
+int ShmStats_Dump(u8* Path)
+{
+	int fd = open(Path, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "stats shm [%s] open failed %i %s\n", Path, errno, strerror(errno));
+		return 1;
+	}
+	ShmStats_t* Shm = mmap(NULL, sizeof(ShmStats_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (Shm == MAP_FAILED)
+	{
+		fprintf(stderr, "stats shm [%s] map failed %i %s\n", Path, errno, strerror(errno));
+		return 1;
+	}
+	if ((Shm->Magic != SHMSTATS_MAGIC) || (Shm->Version != SHMSTATS_VERSION))
+	{
+		fprintf(stderr, "stats shm [%s] invalid magic %08x version %i\n", Path, Shm->Magic, Shm->Version);
+		return 1;
+	}
+
+	ShmStats_t S;
+	u32 Retry = 0;
+	while (true)
+	{
+		u32 Seq0 = __atomic_load_n(&Shm->Seq, __ATOMIC_ACQUIRE);
+		if ((Seq0 & 1) == 0)
+		{
+			memcpy(&S, Shm, sizeof(S));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+			u32 Seq1 = __atomic_load_n(&Shm->Seq, __ATOMIC_RELAXED);
+			if (Seq0 == Seq1) break;
+		}
+		if (Retry++ > 1e6)
+		{
+			fprintf(stderr, "stats shm [%s] no consistent snapshot\n", Path);
+			return 1;
+		}
+	}
+	munmap(Shm, sizeof(ShmStats_t));
+	S.FileName[sizeof(S.FileName) - 1] = 0;
+
+	printf("# TYPE pcap_split_up gauge\n");
+	printf("pcap_split_up{pid=\"%i\"} %i\n", S.PID, S.IsRunning);
+	printf("# TYPE pcap_split_start_time_seconds gauge\n");
+	printf("pcap_split_start_time_seconds %.3f\n", S.StartTS / 1e9);
+	printf("# TYPE pcap_split_update_time_seconds gauge\n");
+	printf("pcap_split_update_time_seconds %.3f\n", S.UpdateTS / 1e9);
+
+	printf("# TYPE pcap_split_bytes_total counter\n");
+	printf("pcap_split_bytes_total %lli\n", S.TotalByte);
+	printf("# TYPE pcap_split_packets_total counter\n");
+	printf("pcap_split_packets_total %lli\n", S.TotalPkt);
+	printf("# TYPE pcap_split_splits_total counter\n");
+	printf("pcap_split_splits_total %lli\n", S.TotalSplit);
+	printf("# TYPE pcap_split_dropped_packets_total counter\n");
+	printf("pcap_split_dropped_packets_total %lli\n", S.DropPkt);
+	printf("# TYPE pcap_split_resync_bytes_total counter\n");
+	printf("pcap_split_resync_bytes_total %lli\n", S.ResyncByte);
+	printf("# TYPE pcap_split_last_packet_timestamp_seconds gauge\n");
+	printf("pcap_split_last_packet_timestamp_seconds %.9f\n", S.LastPCAPTS / 1e9);
+
+	printf("# TYPE pcap_split_output_buffers_used gauge\n");
+	printf("pcap_split_output_buffers_used %lli\n", S.OutputBufferUsed);
+	printf("# TYPE pcap_split_output_buffers gauge\n");
+	printf("pcap_split_output_buffers %lli\n", S.OutputBufferTotal);
+	printf("# TYPE pcap_split_ring_occupancy gauge\n");
+	printf("pcap_split_ring_occupancy %lli\n", S.RingOccupancy);
+	printf("# TYPE pcap_split_ring_depth gauge\n");
+	printf("pcap_split_ring_depth %lli\n", S.RingDepth);
+	printf("# TYPE pcap_split_ring_occupancy_high gauge\n");
+	printf("pcap_split_ring_occupancy_high %lli\n", S.RingHigh);
+	printf("# TYPE pcap_split_ring_degrade_active gauge\n");
+	printf("pcap_split_ring_degrade_active %lli\n", S.RingDegradeActive);
+	printf("# TYPE pcap_split_ring_degraded_packets_total counter\n");
+	printf("pcap_split_ring_degraded_packets_total %lli\n", S.RingDegradePkt);
+	printf("# TYPE pcap_split_output_blocked_seconds_total counter\n");
+	printf("pcap_split_output_blocked_seconds_total %.6f\n", S.OutputBlockNS / 1e9);
+	printf("# TYPE pcap_split_hook_queue_depth gauge\n");
+	printf("pcap_split_hook_queue_depth %lli\n", S.HookQueueDepth);
+
+	printf("# TYPE pcap_split_current_split_bytes gauge\n");
+	printf("pcap_split_current_split_bytes{file=\"%s\"} %lli\n", S.FileName, S.SplitByte);
+	printf("# TYPE pcap_split_current_split_packets gauge\n");
+	printf("pcap_split_current_split_packets{file=\"%s\"} %lli\n", S.FileName, S.SplitPkt);
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// live stats published in a shared memory block
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __SHMSTATS_H__
+#define __SHMSTATS_H__
+
+#define SHMSTATS_MAGIC					0x53504c54			// "SPLT"
+#define SHMSTATS_VERSION				2
+
+// fixed layout, only ever append fields and bump the version
+typedef struct
+{
+	u32					Magic;
+	u32					Version;
+	volatile u32		Seq;								// seqlock, odd while being updated
+	u32					PID;
+	u32					IsRunning;
+	u32					pad0;
+
+	u64					UpdateTS;							// wall time of the last update
+	u64					StartTS;							// wall time pcap_split started
+
+	u64					TotalByte;
+	u64					TotalPkt;
+	u64					TotalSplit;
+	u64					DropPkt;							// packets not written to any split
+	u64					ResyncByte;							// corrupt input bytes skipped
+	u64					LastPCAPTS;							// timestamp of the last packet
+
+	u64					OutputBufferUsed;					// io_uring buffers in flight
+	u64					OutputBufferTotal;
+	u64					RingOccupancy;						// lxc ring entries pending
+	u64					RingDepth;
+	u64					HookQueueDepth;						// retention deletes / hooks pending
+
+	u64					SplitByte;							// current split
+	u64					SplitPkt;
+	u8					FileName[512];
+
+	// version 2
+	u64					RingHigh;							// lxc ring occupancy high water mark
+	u64					RingDegradeActive;					// degrade policy currently on
+	u64					RingDegradePkt;						// packets sliced or sampled out
+	u64					OutputBlockNS;						// time blocked on output writes
+
+} ShmStats_t;
+
+ShmStats_t*			ShmStats_Open		(u8* Path);
+int					ShmStats_Dump		(u8* Path);
+
+// single writer seqlock, readers retry while Seq is odd or changed underneath them
+static INLINE void ShmStats_Begin(ShmStats_t* S)
+{
+	__atomic_store_n(&S->Seq, S->Seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static INLINE void ShmStats_End(ShmStats_t* S)
+{
+	__atomic_store_n(&S->Seq, S->Seq + 1, __ATOMIC_RELEASE);
+}
+
+#endif
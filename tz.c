@@ -0,0 +1,305 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// local timezone transition table
+//
+// the zone's TZif file is read once at startup into a sorted list of (start, utc offset)
+// so the per packet local time is a range check against the cached entry, with a binary
+// search only when a packet crosses into a new entry. TZif files only list transitions up
+// to the point where a fixed rule (the POSIX footer) takes over, after that the table is
+// extended a year at a time by stepping localtime() a day at a time and bisecting to the
+// second where the offset changes. when there is no TZif file (e.g TZ holds a POSIX rule)
+// the whole table is built that way
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fTypes.h"
+#include "tz.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define TZ_START_MIN					(-(1LL << 40))		// first entry, before any transition
+#define TZ_EXTEND_SEC					(366LL * 86400)		// derived entries are added a year at a time
+#define TZ_PROBE_SEC					86400				// at most one transition per probe step
+
+typedef struct
+{
+	s64					Start;								// epoch sec this offset starts
+	s32					Offset;								// utc offset in seconds
+	u8					Zone[8];							// abbreviation
+
+} TZTrans_t;
+
+static TZTrans_t*		s_Trans			= NULL;
+static u32				s_TransCnt		= 0;
+static u32				s_TransMax		= 0;
+static u32				s_FileCnt		= 0;				// entries from the TZif file
+
+static s64				s_TableEnd		= TZ_START_MIN;		// entries are complete up to here
+static bool				s_IsFixed		= false;			// no transitions ever, e.g UTC
+
+// last lookup, in nanos
+static s64				s_CacheStart	= 1;
+static s64				s_CacheEnd		= 0;
+static s64				s_CacheOffset	= 0;
+static u8*				s_CacheZone		= "";
+
+//---------------------------------------------------------------------------------------------
+
+static void TransAdd(s64 Start, s32 Offset, u8* Zone)
+{
+	// no change, nothing to add
+	if (s_TransCnt > 0)
+	{
+		TZTrans_t* L = &s_Trans[s_TransCnt - 1];
+		if ((L->Offset == Offset) && (strncmp(L->Zone, Zone, sizeof(L->Zone) - 1) == 0)) return;
+	}
+	if (s_TransCnt == s_TransMax)
+	{
+		s_TransMax	= (s_TransMax == 0) ? 256 : s_TransMax * 2;
+		s_Trans		= realloc(s_Trans, s_TransMax * sizeof(TZTrans_t));
+		assert(s_Trans != NULL);
+	}
+
+	TZTrans_t* T = &s_Trans[s_TransCnt++];
+	memset(T, 0, sizeof(TZTrans_t));
+	T->Start	= Start;
+	T->Offset	= Offset;
+	strncpy(T->Zone, Zone, sizeof(T->Zone) - 1);
+}
+
+static INLINE u32 Load32BE(u8* p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static INLINE s64 Load64BE(u8* p)
+{
+	return ((u64)Load32BE(p) << 32) | Load32BE(p + 4);
+}
+
+//---------------------------------------------------------------------------------------------
+// RFC 8536 TZif. v2+ files repeat the data with 64bit times after the v1 block, use those
+
+static bool TZifLoad(u8* FileName)
+{
+	FILE* F = fopen(FileName, "rb");
+	if (!F) return false;
+
+	static u8 Buffer[kKB(256)];
+	u32 Length = fread(Buffer, 1, sizeof(Buffer), F);
+	fclose(F);
+
+	if ((Length < 44) || (memcmp(Buffer, "TZif", 4) != 0)) return false;
+
+	u8* p			= Buffer;
+	u8* End			= Buffer + Length;
+	u32 TimeSize	= 4;
+	for (int Pass=0; Pass < 2; Pass++)
+	{
+		if (p + 44 > End) return false;
+
+		u32 IsUTCnt		= Load32BE(p + 20);
+		u32 IsStdCnt	= Load32BE(p + 24);
+		u32 LeapCnt		= Load32BE(p + 28);
+		u32 TimeCnt		= Load32BE(p + 32);
+		u32 TypeCnt		= Load32BE(p + 36);
+		u32 CharCnt		= Load32BE(p + 40);
+
+		u64 DataSize	= TimeCnt * TimeSize + TimeCnt + TypeCnt * 6 + CharCnt + LeapCnt * (TimeSize + 4) + IsStdCnt + IsUTCnt;
+		if ((TypeCnt == 0) || (p + 44 + DataSize > End)) return false;
+
+		// skip the 32bit block
+		if ((Pass == 0) && (Buffer[4] >= '2'))
+		{
+			p			+= 44 + DataSize;
+			TimeSize	 = 8;
+			continue;
+		}
+
+		u8* Times		= p + 44;
+		u8* Index		= Times + TimeCnt * TimeSize;
+		u8* Types		= Index + TimeCnt;
+		u8* Chars		= Types + TypeCnt * 6;
+
+		// type 0 is local time before the first transition
+		for (int i=-1; i < (s32)TimeCnt; i++)
+		{
+			u32 Type	= (i < 0) ? 0 : Index[i];
+			if (Type >= TypeCnt) return false;
+
+			u8* Info	= Types + Type * 6;
+			s32 Offset	= (s32)Load32BE(Info);
+			u32 Abbr	= Info[5];
+			if (Abbr >= CharCnt) return false;
+
+			s64 Start	= TZ_START_MIN;
+			if (i >= 0) Start = (TimeSize == 8) ? Load64BE(Times + i * 8) : (s32)Load32BE(Times + i * 4);
+
+			TransAdd(Start, Offset, Chars + Abbr);
+		}
+		s_TableEnd	= (TimeCnt > 0) ? s_Trans[s_TransCnt - 1].Start : TZ_START_MIN;
+		s_FileCnt	= s_TransCnt;
+		return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------
+
+static void Probe(s64 t, s32* pOffset, u8* Zone)
+{
+	time_t t0 = t;
+	struct tm lt;
+	localtime_r(&t0, &lt);
+
+	*pOffset = lt.tm_gmtoff;
+	strncpy(Zone, lt.tm_zone ? lt.tm_zone : "", 7);
+	Zone[7] = 0;
+}
+
+// derive entries from localtime() until a year past t
+static void Extend(s64 t)
+{
+	s32 Offset;
+	u8 Zone[8];
+
+	// nothing from tzdata, start a year back
+	if (s_TransCnt == 0)
+	{
+		s_TableEnd = t - TZ_EXTEND_SEC;
+		Probe(s_TableEnd, &Offset, Zone);
+		TransAdd(TZ_START_MIN, Offset, Zone);
+	}
+
+	// tzdata ends decades back, dont step through all of it
+	if (s_TableEnd < t - 50 * TZ_EXTEND_SEC)
+	{
+		s_TableEnd = t - TZ_EXTEND_SEC;
+		Probe(s_TableEnd, &Offset, Zone);
+		TransAdd(s_TableEnd, Offset, Zone);
+	}
+
+	s64 End = t + TZ_EXTEND_SEC;
+	for (s64 T0 = s_TableEnd; T0 < End; T0 += TZ_PROBE_SEC)
+	{
+		s64 T1 = T0 + TZ_PROBE_SEC;
+		Probe(T1, &Offset, Zone);
+
+		TZTrans_t* L = &s_Trans[s_TransCnt - 1];
+		if ((Offset == L->Offset) && (strcmp(Zone, L->Zone) == 0)) continue;
+
+		// first second with the new offset
+		s64 Lo = T0, Hi = T1;
+		while (Hi - Lo > 1)
+		{
+			s64 Mid = Lo + (Hi - Lo) / 2;
+
+			s32 MidOffset;
+			u8 MidZone[8];
+			Probe(Mid, &MidOffset, MidZone);
+
+			if ((MidOffset == L->Offset) && (strcmp(MidZone, L->Zone) == 0))	Lo = Mid;
+			else																Hi = Mid;
+		}
+		TransAdd(Hi, Offset, Zone);
+	}
+	s_TableEnd = End;
+}
+
+static void Lookup(s64 TS)
+{
+	s64 t = TS / (s64)k1E9;
+	if (!s_IsFixed && (t >= s_TableEnd)) Extend(t);
+
+	// last entry starting at or before t
+	s32 Lo = 0, Hi = s_TransCnt - 1;
+	while (Lo < Hi)
+	{
+		s32 Mid = (Lo + Hi + 1) / 2;
+		if (s_Trans[Mid].Start <= t)	Lo = Mid;
+		else							Hi = Mid - 1;
+	}
+
+	TZTrans_t* T	= &s_Trans[Lo];
+	s64 Next		= (Lo + 1 < s_TransCnt) ? s_Trans[Lo + 1].Start : s_TableEnd;
+
+	s_CacheStart	= (T->Start <= -(s64)k1E9 * 8) ? INT64_MIN : T->Start * (s64)k1E9;
+	s_CacheEnd		= (s_IsFixed && (Lo + 1 == s_TransCnt)) ? INT64_MAX : Next * (s64)k1E9;
+	s_CacheOffset	= T->Offset * (s64)k1E9;
+	s_CacheZone		= T->Zone;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void TZ_Open(void)
+{
+	u8 FileName[1024];
+
+	u8* TZ = getenv("TZ");
+	if (TZ && (TZ[0] == ':')) TZ++;
+
+	if (TZ == NULL)
+	{
+		strcpy(FileName, "/etc/localtime");
+	}
+	else if (TZ[0] == 0)
+	{
+		// empty TZ is UTC
+		TransAdd(TZ_START_MIN, 0, "UTC");
+		s_IsFixed = true;
+		return;
+	}
+	else if (TZ[0] == '/')
+	{
+		strncpy(FileName, TZ, sizeof(FileName) - 1);
+	}
+	else
+	{
+		u8* Dir = getenv("TZDIR");
+		snprintf(FileName, sizeof(FileName), "%s/%s", Dir ? Dir : (u8*)"/usr/share/zoneinfo", TZ);
+	}
+
+	if (!TZifLoad(FileName))
+	{
+		// half loaded file, derive everything from localtime()
+		s_TransCnt	= 0;
+		s_FileCnt	= 0;
+		s_TableEnd	= TZ_START_MIN;
+		return;
+	}
+
+	// single type and no transitions, e.g UTC
+	if (s_TransCnt == 1)
+	{
+		s32 Offset;
+		u8 Zone[8];
+		Probe(time(NULL), &Offset, Zone);
+		s_IsFixed = (Offset == s_Trans[0].Offset);
+	}
+}
+
+s64 TZ_Offset(s64 TS)
+{
+	if ((TS < s_CacheStart) || (TS >= s_CacheEnd)) Lookup(TS);
+	return s_CacheOffset;
+}
+
+u8* TZ_Zone(s64 TS)
+{
+	if ((TS < s_CacheStart) || (TS >= s_CacheEnd)) Lookup(TS);
+	return s_CacheZone;
+}
+
+void TZ_Stats(u32* pFileCnt, u32* pTotalCnt)
+{
+	if (pFileCnt)	pFileCnt[0]		= s_FileCnt;
+	if (pTotalCnt)	pTotalCnt[0]	= s_TransCnt;
+}
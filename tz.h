@@ -0,0 +1,24 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// local timezone transition table
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __TZ_H__
+#define __TZ_H__
+
+// load the transitions for $TZ or /etc/localtime
+void				TZ_Open				(void);
+
+// utc offset in nanos at epoch nanos TS
+s64					TZ_Offset			(s64 TS);
+
+// zone abbreviation at epoch nanos TS, e.g "EST"
+u8*					TZ_Zone				(s64 TS);
+
+// number of transitions loaded from tzdata / derived
+void				TZ_Stats			(u32* pFileCnt, u32* pTotalCnt);
+
+#endif
@@ -0,0 +1,444 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// background upload of closed splits from the local spool
+//
+// instead of piping every split straight to rclone / curl / ssh, where any remote slowdown
+// stalls the pipe and with it the capture loop, the split is written to a local spool at full
+// speed and queued here on close. a pool of worker threads drains the spool with bounded
+// concurrency and retries with backoff. if the spool grows past its limit the oldest waiting
+// split is dropped, so a long WAN outage can not fill the local disk
+//
+// curl workers each keep a libcurl handle for the whole run, so the control / http connection
+// and login are reused from split to split. ftp uploads go to <name>.pending and are renamed
+// with RNFR / RNTO on the same connection, retries resume from the size already on the server.
+// built without FMADIO_LIBCURL, or when --upload-curl has args with no libcurl equivalent,
+// the workers run the curl command line per split instead
+//
+// rclone uploads with copyto. ssh streams into <name>.pending and only renames it once the
+// remote size matches, running over the shared control master when there is one
+//
+//---------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef FMADIO_LIBCURL
+#include <curl/curl.h>
+#endif
+
+#include "fTypes.h"
+#include "upload.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define UPLOAD_QUEUE_MAX				4096				// splits waiting, the writer blocks beyond this
+#define UPLOAD_WORKER_MAX				64
+
+typedef struct
+{
+	u8					Local[1024];
+	u8					Remote[1024];
+	u64					Size;
+
+} UploadJob_t;
+
+typedef struct
+{
+	u32					Index;
+	pthread_t			Thread;
+
+#ifdef FMADIO_LIBCURL
+	CURL*				CURL;								// kept for the run so connections are reused
+#endif
+
+} UploadWorker_t;
+
+static UploadConfig_t	s_Config;
+static bool				s_IsFTP				= false;		// rename via .pending
+static u8				s_Prefix[1024];					// filename prefix part of the URL
+
+// options picked out of the curl args for libcurl
+static bool				s_IsLibCURL			= false;		// curl args all map to libcurl options
+static u8				s_UserPwd[1024]		= { 0 };
+static bool				s_IsInsecure		= false;
+static bool				s_IsCreateDirs		= false;
+
+static UploadWorker_t	s_Worker[UPLOAD_WORKER_MAX];
+
+static pthread_mutex_t	s_Lock				= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	s_CondPut			= PTHREAD_COND_INITIALIZER;	// job queued
+static pthread_cond_t	s_CondGet			= PTHREAD_COND_INITIALIZER;	// slot freed
+static UploadJob_t*		s_Queue				= NULL;
+static u32				s_QueuePut			= 0;
+static u32				s_QueueGet			= 0;
+static volatile u32		s_QueueDepth		= 0;				// queued + in progress
+static u32				s_QueueWait			= 0;				// queued, not yet picked up
+static volatile u64		s_QueueByte			= 0;				// spool bytes queued + in progress
+static volatile bool	s_ThreadExit		= false;
+
+static volatile u64		s_DoneCnt			= 0;
+static volatile u64		s_DoneByte			= 0;
+static volatile u64		s_FailCnt			= 0;
+static volatile u64		s_DropCnt			= 0;				// dropped for the spool limit
+
+//---------------------------------------------------------------------------------------------
+// command line uploads, true on a zero exit status
+
+static bool UploadCmd(u8* Cmd, u8* Remote, u32 Attempt)
+{
+	int Status = system(Cmd);
+	if (!WIFEXITED(Status) || (WEXITSTATUS(Status) != 0))
+	{
+		fprintf(stderr, "upload [%s] attempt %i failed [%s]\n", Remote, Attempt, Cmd);
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------
+
+#ifdef FMADIO_LIBCURL
+
+static int UploadSeek(void* User, curl_off_t Offset, int Origin)
+{
+	return (fseeko((FILE*)User, Offset, Origin) == 0) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+static bool UploadCURL(UploadWorker_t* W, u8* Local, u8* Remote, u64 Size, u32 Attempt)
+{
+	FILE* F = fopen(Local, "rb");
+	if (!F)
+	{
+		fprintf(stderr, "upload [%s] open failed %i %s\n", Local, errno, strerror(errno));
+		return false;
+	}
+
+	u8 URL[4096];
+	sprintf(URL, "%s%s%s", s_Config.URL, Remote, s_IsFTP ? ".pending" : "");
+
+	// reset keeps the connection cache
+	CURL* C = W->CURL;
+	curl_easy_reset(C);
+	curl_easy_setopt(C, CURLOPT_URL,				URL);
+	curl_easy_setopt(C, CURLOPT_UPLOAD,				1L);
+	curl_easy_setopt(C, CURLOPT_READDATA,			F);
+	curl_easy_setopt(C, CURLOPT_SEEKFUNCTION,		UploadSeek);
+	curl_easy_setopt(C, CURLOPT_SEEKDATA,			F);
+	curl_easy_setopt(C, CURLOPT_INFILESIZE_LARGE,	(curl_off_t)Size);
+	curl_easy_setopt(C, CURLOPT_NOSIGNAL,			1L);
+	curl_easy_setopt(C, CURLOPT_TCP_KEEPALIVE,		1L);
+	curl_easy_setopt(C, CURLOPT_FAILONERROR,		1L);
+
+	if (s_UserPwd[0]) curl_easy_setopt(C, CURLOPT_USERPWD, s_UserPwd);
+	if (s_IsInsecure)
+	{
+		curl_easy_setopt(C, CURLOPT_SSL_VERIFYPEER, 0L);
+		curl_easy_setopt(C, CURLOPT_SSL_VERIFYHOST, 0L);
+	}
+	if (s_IsCreateDirs) curl_easy_setopt(C, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_RETRY);
+
+	// retry continues after whatever reached the server
+	if (s_IsFTP && (Attempt > 0)) curl_easy_setopt(C, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)-1);
+
+	// rename on the same connection once the data is complete
+	struct curl_slist* Quote = NULL;
+	if (s_IsFTP)
+	{
+		u8 Cmd[2048];
+		sprintf(Cmd, "RNFR %s%s.pending", s_Prefix, Remote);
+		Quote = curl_slist_append(Quote, Cmd);
+		sprintf(Cmd, "RNTO %s%s", s_Prefix, Remote);
+		Quote = curl_slist_append(Quote, Cmd);
+		curl_easy_setopt(C, CURLOPT_POSTQUOTE, Quote);
+	}
+
+	CURLcode Result = curl_easy_perform(C);
+
+	curl_slist_free_all(Quote);
+	fclose(F);
+
+	if (Result != CURLE_OK)
+	{
+		fprintf(stderr, "upload [%s] attempt %i failed: %s\n", URL, Attempt, curl_easy_strerror(Result));
+		return false;
+	}
+	return true;
+}
+
+#endif
+
+// one curl process per split, no connection reuse
+static bool UploadCURLCmd(u8* Local, u8* Remote, u32 Attempt)
+{
+	u8 Cmd[8*1024];
+	u32 Pos = sprintf(Cmd, "curl -s -S --fail %s%s -T \"%s\" \"%s%s%s\"",	s_Config.CURLArg,
+																			(s_IsFTP && (Attempt > 0)) ? " -C -" : "",
+																			Local,
+																			s_Config.URL, Remote, s_IsFTP ? ".pending" : "");
+	if (s_IsFTP)
+	{
+		sprintf(Cmd + Pos, " -Q \"-RNFR %s%s.pending\" -Q \"-RNTO %s%s\"", s_Prefix, Remote, s_Prefix, Remote);
+	}
+	return UploadCmd(Cmd, Remote, Attempt);
+}
+
+//---------------------------------------------------------------------------------------------
+// one attempt at uploading a spooled split
+
+static bool UploadFile(UploadWorker_t* W, u8* Local, u8* Remote, u64 Size, u32 Attempt)
+{
+	u8 Cmd[8*1024];
+	switch (s_Config.Mode)
+	{
+	case UPLOAD_MODE_CURL:
+#ifdef FMADIO_LIBCURL
+		if (s_IsLibCURL) return UploadCURL(W, Local, Remote, Size, Attempt);
+#endif
+		return UploadCURLCmd(Local, Remote, Attempt);
+
+	case UPLOAD_MODE_RCLONE:
+		sprintf(Cmd, "rclone --config=/opt/fmadio/etc/rclone.conf --ignore-checksum copyto \"%s\" \"%s%s\"", Local, s_Config.URL, Remote);
+		return UploadCmd(Cmd, Remote, Attempt);
+
+	case UPLOAD_MODE_SSH:
+		// a dropped connection ends the remote cat cleanly, so check the size before the rename
+		sprintf(Cmd, "ssh %s %s \"cat > %s%s.pending && [ \\$(stat -c %%s %s%s.pending) = %lli ] && mv %s%s.pending %s%s\" < \"%s\"",
+																s_Config.SSHOpt, s_Config.SSHHost,
+																s_Config.URL, Remote,
+																s_Config.URL, Remote, Size,
+																s_Config.URL, Remote, s_Config.URL, Remote,
+																Local);
+		return UploadCmd(Cmd, Remote, Attempt);
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------
+
+static void* UploadThread(void* User)
+{
+	UploadWorker_t* W = (UploadWorker_t*)User;
+
+	UploadJob_t Job;
+	while (true)
+	{
+		pthread_mutex_lock(&s_Lock);
+		while ((s_QueueWait == 0) && !s_ThreadExit)
+		{
+			pthread_cond_wait(&s_CondPut, &s_Lock);
+		}
+		if (s_QueueWait == 0)
+		{
+			pthread_mutex_unlock(&s_Lock);
+			break;
+		}
+		Job = s_Queue[s_QueueGet];
+		s_QueueGet = (s_QueueGet + 1) % UPLOAD_QUEUE_MAX;
+		s_QueueWait--;
+		pthread_mutex_unlock(&s_Lock);
+
+		u64 Size = Job.Size;
+
+		bool IsDone = false;
+		u32 Delay = s_Config.RetryDelay;
+		for (int Attempt=0; Attempt < s_Config.RetryMax; Attempt++)
+		{
+			if (Attempt > 0)
+			{
+				usleep(Delay * 1000);
+				Delay *= 2;
+			}
+			IsDone = UploadFile(W, Job.Local, Job.Remote, Size, Attempt);
+			if (IsDone) break;
+		}
+
+		if (IsDone)
+		{
+			unlink(Job.Local);
+
+			__atomic_add_fetch(&s_DoneCnt, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&s_DoneByte, Size, __ATOMIC_RELAXED);
+		}
+		else
+		{
+			// left in place for a manual re-upload
+			fprintf(stderr, "upload [%s] gave up after %i attempts, kept [%s]\n", Job.Remote, s_Config.RetryMax, Job.Local);
+			__atomic_add_fetch(&s_FailCnt, 1, __ATOMIC_RELAXED);
+		}
+
+		pthread_mutex_lock(&s_Lock);
+		s_QueueDepth--;
+		s_QueueByte -= Size;
+		pthread_cond_broadcast(&s_CondGet);
+		pthread_mutex_unlock(&s_Lock);
+	}
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------
+
+#ifdef FMADIO_LIBCURL
+
+// curl command line args that have a libcurl equivalent. false if any does not, the
+// command line is then used so the upload behaves exactly as configured
+static bool ParseArgs(u8* Args)
+{
+
+	u8 Buffer[4096];
+	strncpy(Buffer, Args, sizeof(Buffer) - 1);
+	Buffer[sizeof(Buffer) - 1] = 0;
+
+	char* Save = NULL;
+	for (u8* Arg = strtok_r(Buffer, " ", &Save); Arg != NULL; Arg = strtok_r(NULL, " ", &Save))
+	{
+		if ((strcmp(Arg, "-u") == 0) || (strcmp(Arg, "--user") == 0))
+		{
+			u8* User = strtok_r(NULL, " ", &Save);
+			if (User) strncpy(s_UserPwd, User, sizeof(s_UserPwd) - 1);
+		}
+		else if ((strcmp(Arg, "-k") == 0) || (strcmp(Arg, "--insecure") == 0))
+		{
+			s_IsInsecure = true;
+		}
+		else if (strcmp(Arg, "--ftp-create-dirs") == 0)
+		{
+			s_IsCreateDirs = true;
+		}
+		else if ((strcmp(Arg, "-s") != 0) && (strcmp(Arg, "-p") != 0))
+		{
+			fprintf(stderr, "upload: curl arg [%s] has no libcurl equivalent, using the curl command line\n", Arg);
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif
+
+void Upload_Open(UploadConfig_t* Config)
+{
+	s_Config = *Config;
+	if (s_Config.WorkerCnt == 0) s_Config.WorkerCnt = 1;
+	if (s_Config.WorkerCnt > UPLOAD_WORKER_MAX) s_Config.WorkerCnt = UPLOAD_WORKER_MAX;
+	if (s_Config.RetryMax == 0) s_Config.RetryMax = 1;
+
+	s_IsFTP = (s_Config.Mode == UPLOAD_MODE_CURL) && (strncmp(s_Config.URL, "ftp", 3) == 0);
+
+	// names in RNFR / RNTO are relative to the directory part of the URL
+	u8* Slash = strrchr(s_Config.URL, '/');
+	strcpy(s_Prefix, Slash ? Slash + 1 : s_Config.URL);
+
+	s_Queue = calloc(UPLOAD_QUEUE_MAX, sizeof(UploadJob_t));
+	assert(s_Queue != NULL);
+
+#ifdef FMADIO_LIBCURL
+	curl_global_init(CURL_GLOBAL_ALL);
+	if (s_Config.Mode == UPLOAD_MODE_CURL) s_IsLibCURL = ParseArgs(s_Config.CURLArg);
+#endif
+
+	for (int i=0; i < s_Config.WorkerCnt; i++)
+	{
+		UploadWorker_t* W = &s_Worker[i];
+		W->Index = i;
+
+#ifdef FMADIO_LIBCURL
+		W->CURL = curl_easy_init();
+		assert(W->CURL != NULL);
+#endif
+		pthread_create(&W->Thread, NULL, UploadThread, W);
+	}
+
+	static const u8* ModeName[] = { "curl cmd", "rclone", "ssh" };
+
+	fprintf(stderr, "upload: %i workers %s [%s] spool max %.3f GB\n", s_Config.WorkerCnt, s_IsLibCURL ? "libcurl" : ModeName[s_Config.Mode], s_Config.URL, s_Config.SpoolMax / 1e9);
+}
+
+void Upload_Close(void)
+{
+	if (!s_Queue) return;
+
+	if (s_QueueDepth > 0) printf("upload: waiting for %i uploads\n", s_QueueDepth);
+
+	pthread_mutex_lock(&s_Lock);
+	s_ThreadExit = true;
+	pthread_cond_broadcast(&s_CondPut);
+	pthread_mutex_unlock(&s_Lock);
+
+	for (int i=0; i < s_Config.WorkerCnt; i++)
+	{
+		pthread_join(s_Worker[i].Thread, NULL);
+
+#ifdef FMADIO_LIBCURL
+		curl_easy_cleanup(s_Worker[i].CURL);
+#endif
+	}
+
+#ifdef FMADIO_LIBCURL
+	curl_global_cleanup();
+#endif
+
+	free(s_Queue);
+	s_Queue = NULL;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void Upload_Queue(u8* LocalFile, u8* RemoteName)
+{
+	struct stat st;
+	u64 Size = (stat(LocalFile, &st) == 0) ? st.st_size : 0;
+
+	pthread_mutex_lock(&s_Lock);
+
+	// spool full, drop the oldest split still waiting
+	while ((s_Config.SpoolMax > 0) && (s_QueueWait > 0) && (s_QueueByte + Size > s_Config.SpoolMax))
+	{
+		UploadJob_t* Old = &s_Queue[s_QueueGet];
+		s_QueueGet = (s_QueueGet + 1) % UPLOAD_QUEUE_MAX;
+		s_QueueWait--;
+		s_QueueDepth--;
+		s_QueueByte -= Old->Size;
+		s_DropCnt++;
+
+		fprintf(stderr, "upload: spool full, dropping [%s] %.3f GB\n", Old->Local, Old->Size / 1e9);
+		unlink(Old->Local);
+	}
+
+	// uploads cant keep up, hold the writer until a slot frees
+	while (s_QueueDepth >= UPLOAD_QUEUE_MAX)
+	{
+		pthread_cond_wait(&s_CondGet, &s_Lock);
+	}
+
+	UploadJob_t* Job = &s_Queue[s_QueuePut];
+	strncpy(Job->Local, LocalFile, sizeof(Job->Local) - 1);
+	strncpy(Job->Remote, RemoteName, sizeof(Job->Remote) - 1);
+	Job->Size = Size;
+	s_QueuePut = (s_QueuePut + 1) % UPLOAD_QUEUE_MAX;
+
+	s_QueueDepth++;
+	s_QueueWait++;
+	s_QueueByte += Size;
+
+	pthread_cond_signal(&s_CondPut);
+	pthread_mutex_unlock(&s_Lock);
+}
+
+void Upload_Stats(u64* pDoneCnt, u64* pDoneByte, u64* pFailCnt, u64* pDropCnt, u32* pQueueDepth, u64* pQueueByte)
+{
+	if (pDoneCnt)		pDoneCnt[0]		= s_DoneCnt;
+	if (pDoneByte)		pDoneByte[0]	= s_DoneByte;
+	if (pFailCnt)		pFailCnt[0]		= s_FailCnt;
+	if (pDropCnt)		pDropCnt[0]		= s_DropCnt;
+	if (pQueueDepth)	pQueueDepth[0]	= s_QueueDepth;
+	if (pQueueByte)		pQueueByte[0]	= s_QueueByte;
+}
@@ -0,0 +1,41 @@
+//---------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2017-2022, fmad engineering llc
+//
+// background upload of closed splits from the local spool
+//
+//---------------------------------------------------------------------------------------------
+
+#ifndef __UPLOAD_H__
+#define __UPLOAD_H__
+
+#define UPLOAD_MODE_CURL				0					// libcurl or the curl command line
+#define UPLOAD_MODE_RCLONE				1					// rclone copyto
+#define UPLOAD_MODE_SSH					2					// ssh cat to .pending then mv
+
+typedef struct
+{
+	u32				Mode;								// UPLOAD_MODE_*
+	u32				WorkerCnt;							// parallel uploads
+	u32				RetryMax;							// attempts per split
+	u32				RetryDelay;							// msec before the first retry, doubles each time
+	u64				SpoolMax;							// bytes waiting in the spool before the oldest is dropped, 0 for no limit
+
+	u8*				CURLArg;							// curl command line args, -u / -k / --ftp-create-dirs used natively
+	u8*				SSHOpt;								// ssh options and host
+	u8*				SSHHost;
+	u8*				URL;								// remote directory + prefix, the split name is appended
+
+} UploadConfig_t;
+
+void				Upload_Open			(UploadConfig_t* Config);
+
+// drains every queued upload
+void				Upload_Close		(void);
+
+// upload LocalFile as URL + RemoteName, the local file is deleted once uploaded
+void				Upload_Queue		(u8* LocalFile, u8* RemoteName);
+
+void				Upload_Stats		(u64* pDoneCnt, u64* pDoneByte, u64* pFailCnt, u64* pDropCnt, u32* pQueueDepth, u64* pQueueByte);
+
+#endif